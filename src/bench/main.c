@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2021-2022 Wojciech Graj
+ *
+ * Licensed under the MIT license: https://opensource.org/licenses/MIT
+ * Permission is granted to use, copy, modify, and redistribute the work.
+ * Full license information available in the project LICENSE file.
+ *
+ * DESCRIPTION:
+ *   Benchmark driver which renders the bundled scenes with the raytracer
+ **/
+
+#define _DEFAULT_SOURCE /* wait4 */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "argv.h"
+#include "error.h"
+#include "mem.h"
+#include "system.h"
+
+#include "cJSON.h"
+
+#define TRACE_FILENAME "bench_trace.json"
+#define IMAGE_FILENAME "bench_image.tif"
+#define MIN_COMPARED_TIME 1e-3 /* Shorter times are dominated by noise */
+
+struct BenchCase {
+	const char *scene;
+	uint32_t resolution[2];
+	uint32_t samples;
+	const char *global_illumination;
+};
+
+struct BenchResult {
+	bool ok;
+	double bvh_time;
+	double render_time;
+	uint64_t rays;
+	long peak_rss_kb;
+};
+
+static const char *HELPTEXT =
+	"Benchmark the raytracer on the bundled scenes.\n"
+	"Copyright: (c) 2021-2022 Wojciech Graj\n"
+	"License: https://opensource.org/licenses/MIT\n"
+	"\n"
+	"Usage: ./benchmark [OPTIONAL_PARAMETERS]\n"
+	"\n"
+	"OPTIONAL PARAMETERS:\n"
+	"[-e] (string)                    : DEFAULT = ./engine    : raytracer executable.\n"
+	"[-o] (string)                    : DEFAULT = bench.csv   : CSV report to which results are saved.\n"
+	"[-t] (integer | \"max\")           : DEFAULT = max         : thread count of multithreaded runs. Every case is also run with 1 thread.\n"
+	"[-k] (integer)                   : DEFAULT = 1           : repetitions of each run. The fastest is reported.\n"
+	"[-c] (string)                    : DEFAULT = OFF         : CSV report to compare against. Exits with 1 on regression.\n"
+	"[-x] (float)                     : DEFAULT = 5.0         : percentage by which a time must exceed the baseline to be a regression.\n";
+
+/* Fixed workload so that reports are comparable between revisions */
+static const struct BenchCase BENCH_CASES[] = {
+	{ "scenes/scene1.json", { 320, 240 }, 1, "ambient" },
+	{ "scenes/scene2.json", { 320, 240 }, 1, "ambient" },
+	{ "scenes/scene3.json", { 320, 240 }, 1, "ambient" },
+	{ "scenes/scene3.json", { 160, 120 }, 16, "path" },
+	{ "scenes/scene4.json", { 320, 240 }, 1, "ambient" },
+	{ "scenes/scene5.json", { 320, 240 }, 1, "ambient" },
+	{ "scenes/scene6.json", { 320, 240 }, 1, "ambient" },
+};
+
+int main(int argc, char *argv[]);
+bool bench_run(const char *engine, const struct BenchCase *bench_case, const char *threads, struct BenchResult *result);
+bool bench_parse_trace(struct BenchResult *result);
+bool bench_compare(const char *filename, const char *key, const struct BenchResult *result, float threshold);
+void bench_case_key(const struct BenchCase *bench_case, const char *threads, char *key, size_t len);
+
+void bench_case_key(const struct BenchCase *bench_case, const char *threads, char *key, const size_t len)
+{
+	snprintf(key, len, "%s,%u,%u,%u,%s,%s", bench_case->scene, bench_case->resolution[X], bench_case->resolution[Y], bench_case->samples, bench_case->global_illumination, threads);
+}
+
+bool bench_parse_trace(struct BenchResult *result)
+{
+	FILE *file = fopen(TRACE_FILENAME, "rb");
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_END);
+	size_t length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char *buffer = safe_malloc(length + 1);
+	size_t nmemb_read = fread(buffer, 1, length, file);
+	fclose(file);
+	buffer[nmemb_read] = '\0';
+	cJSON *json = cJSON_Parse(buffer);
+	free(buffer);
+
+	bool found_bvh = false, found_render = false;
+	cJSON *json_events = cJSON_GetObjectItemCaseSensitive(json, "traceEvents");
+	cJSON *json_iter;
+	cJSON_ArrayForEach (json_iter, json_events) {
+		cJSON *json_name = cJSON_GetObjectItemCaseSensitive(json_iter, "name");
+		cJSON *json_dur = cJSON_GetObjectItemCaseSensitive(json_iter, "dur");
+		if (!cJSON_IsString(json_name) || !cJSON_IsNumber(json_dur))
+			continue;
+		if (!strcmp(json_name->valuestring, "BVH build")) {
+			result->bvh_time = json_dur->valuedouble * 1e-6;
+			found_bvh = true;
+		} else if (!strcmp(json_name->valuestring, "Render")) {
+			result->render_time = json_dur->valuedouble * 1e-6;
+			cJSON *json_detail = cJSON_GetObjectItemCaseSensitive(cJSON_GetObjectItemCaseSensitive(json_iter, "args"), "detail");
+			if (cJSON_IsString(json_detail))
+				result->rays = strtoull(json_detail->valuestring, NULL, 10);
+			found_render = true;
+		}
+	}
+	cJSON_Delete(json);
+	return found_bvh && found_render;
+}
+
+bool bench_run(const char *engine, const struct BenchCase *bench_case, const char *threads, struct BenchResult *result)
+{
+	char resolution[2][16], samples[16];
+	snprintf(resolution[X], sizeof(resolution[X]), "%u", bench_case->resolution[X]);
+	snprintf(resolution[Y], sizeof(resolution[Y]), "%u", bench_case->resolution[Y]);
+	snprintf(samples, sizeof(samples), "%u", bench_case->samples);
+	const char *engine_argv[] = {
+		engine, bench_case->scene, IMAGE_FILENAME, resolution[X], resolution[Y],
+		"-m", threads, "-n", samples, "-g", bench_case->global_illumination,
+		"--trace", TRACE_FILENAME, NULL
+	};
+
+	remove(TRACE_FILENAME);
+	fflush(stdout);
+	pid_t pid = fork();
+	error_check(pid >= 0, "Failed to fork.");
+	if (!pid) {
+		error_check(freopen("/dev/null", "w", stdout), "Failed to redirect output.");
+		execv(engine, (char *const *)engine_argv);
+		_exit(127);
+	}
+
+	int status;
+	struct rusage usage;
+	error_check(wait4(pid, &status, 0, &usage) == pid, "Failed to wait for [%s].", engine);
+	result->ok = WIFEXITED(status) && !WEXITSTATUS(status) && bench_parse_trace(result);
+	result->peak_rss_kb = usage.ru_maxrss;
+	return result->ok;
+}
+
+/* Returns true on regression */
+bool bench_compare(const char *filename, const char *key, const struct BenchResult *result, const float threshold)
+{
+	FILE *file = fopen(filename, "r");
+	error_check(file, "Failed to open baseline [%s].", filename);
+
+	bool regression = false;
+	char line[512];
+	size_t key_len = strlen(key);
+	while (fgets(line, sizeof(line), file)) {
+		if (strncmp(line, key, key_len) || line[key_len] != ',')
+			continue;
+		double bvh_time, render_time;
+		if (sscanf(line + key_len, ",%lf,%lf", &bvh_time, &render_time) != 2 || render_time < 0.)
+			break;
+		double bvh_change = bvh_time > MIN_COMPARED_TIME ? (result->bvh_time / bvh_time - 1.) * 100. : 0.;
+		double render_change = render_time > MIN_COMPARED_TIME ? (result->render_time / render_time - 1.) * 100. : 0.;
+		regression = bvh_change > (double)threshold || render_change > (double)threshold;
+		printf_log("%s BVH %+.1f%%, render %+.1f%%.", regression ? "REGRESSION" : "ok", bvh_change, render_change);
+		break;
+	}
+	fclose(file);
+	return regression;
+}
+
+int main(int argc, char *argv[])
+{
+	myargc = argc;
+	myargv = argv;
+	argv_init();
+
+	if (argv_check("--help") || argv_check("-h")) {
+		puts(HELPTEXT);
+		return 0;
+	}
+
+	system_init();
+
+	int idx;
+	const char *engine = (idx = argv_check_with_args("-e", 1)) ? myargv[idx + 1] : "./engine";
+	const char *report_filename = (idx = argv_check_with_args("-o", 1)) ? myargv[idx + 1] : "bench.csv";
+	const char *threads[2] = { "1", (idx = argv_check_with_args("-t", 1)) ? myargv[idx + 1] : "max" };
+	const char *baseline_filename = (idx = argv_check_with_args("-c", 1)) ? myargv[idx + 1] : NULL;
+	const float threshold = (idx = argv_check_with_args("-x", 1)) ? (float)atof(myargv[idx + 1]) : 5.f;
+	const unsigned repetitions = (idx = argv_check_with_args("-k", 1)) ? abs(atoi(myargv[idx + 1])) : 1;
+
+	FILE *report = fopen(report_filename, "w");
+	error_check(report, "Failed to open report [%s].", report_filename);
+	fputs("scene,width,height,samples,global_illumination,threads,bvh_time,render_time,rays,rays_per_second,peak_rss_kb\n", report);
+
+	unsigned num_regressions = 0;
+	size_t i, j;
+	unsigned k;
+	for (i = 0; i < arrlen(BENCH_CASES); i++) {
+		for (j = 0; j < arrlen(threads); j++) {
+			char key[256];
+			bench_case_key(&BENCH_CASES[i], threads[j], key, sizeof(key));
+			printf_log("Running [%s].", key);
+
+			struct BenchResult best = { 0 };
+			for (k = 0; k < repetitions; k++) {
+				struct BenchResult result = { 0 };
+				if (!bench_run(engine, &BENCH_CASES[i], threads[j], &result))
+					break;
+				if (!best.ok || result.render_time < best.render_time)
+					best = result;
+				if (result.peak_rss_kb > best.peak_rss_kb)
+					best.peak_rss_kb = result.peak_rss_kb;
+			}
+			if (!best.ok) {
+				printf_log("Failed to render [%s].", BENCH_CASES[i].scene);
+				continue;
+			}
+
+			double rays_per_second = best.rays / best.render_time;
+			printf_log("BVH %.3fs, render %.3fs, %.0f rays/s, peak RSS %ld KiB.", best.bvh_time, best.render_time, rays_per_second, best.peak_rss_kb);
+			fprintf(report, "%s,%f,%f,%" PRIu64 ",%.0f,%ld\n", key, best.bvh_time, best.render_time, best.rays, rays_per_second, best.peak_rss_kb);
+			if (baseline_filename)
+				num_regressions += bench_compare(baseline_filename, key, &best, threshold);
+		}
+	}
+
+	fclose(report);
+	remove(TRACE_FILENAME);
+	remove(IMAGE_FILENAME);
+	argv_deinit();
+
+	if (baseline_filename)
+		printf_log("%u regressions exceeding %.1f%%.", num_regressions, (double)threshold);
+	return num_regressions ? 1 : 0;
+}
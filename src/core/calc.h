@@ -14,6 +14,8 @@
 
 #include "type.h"
 
+#include <math.h>
+
 #define SPHERICAL_TO_CARTESIAN(radius, inclination, azimuth)       \
 	{                                                          \
 		radius *cosf(azimuth) * sinf(inclination),         \
@@ -24,35 +26,198 @@
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 
-float sqr(float val);
-float mag2(const v2 vec);
-float mag3(const v3 vec);
-float dot2(const v2 vec1, const v2 vec2);
-float dot3(const v3 vec1, const v3 vec2);
-void cross(const v3 vec1, const v3 vec2, v3 result);
-void mul2s(const v2 vec, float mul, v2 result);
-void mul3s(const v3 vec, float mul, v3 result);
-void mul3v(const v3 vec1, const v3 vec2, v3 result);
-void inv3(v3 vec);
-void add2v(const v2 vec1, const v2 vec2, v2 result);
-void add2s(const v2 vec1, float summand, v2 result);
-void add3v(const v3 vec1, const v3 vec2, v3 result);
-void add3s(const v3 vec1, float summand, v3 result);
-void add3v3(const v3 vec1, const v3 vec2, const v3 vec3, v3 result);
-void sub2v(const v2 vec1, const v2 vec2, v2 result);
-void sub2s(const v2 vec1, float subtrahend, v2 result);
-void sub3v(const v3 vec1, const v3 vec2, v3 result);
-void sub3s(const v3 vec1, float subtrahend, v3 result);
-void norm2(v2 vec);
-void norm3(v3 vec);
-float max3(const v3 vec);
-float min3(const v3 vec);
-float clamp(float num, float min, float max);
-void clamp3(const v3 vec, const v3 min, const v3 max, v3 result);
-float magsqr3(const v3 vec);
-void mulmv(m3 mat, const float *restrict vec, float *restrict result);
-void mulms(m3 mat, float mul, m3 result);
-void assign3(v3 dest, const v3 src);
-void assignm(m3 dest, m3 src);
+__attribute__((const)) static inline float sqr(const float val)
+{
+	return val * val;
+}
+
+__attribute__((pure)) static inline float mag2(const v2 vec)
+{
+	return sqrtf(sqr(vec[X]) + sqr(vec[Y]));
+}
+
+__attribute__((pure)) static inline float magsqr3(const v3 vec)
+{
+	return sqr(vec[X]) + sqr(vec[Y]) + sqr(vec[Z]);
+}
+
+__attribute__((pure)) static inline float mag3(const v3 vec)
+{
+	return sqrtf(magsqr3(vec));
+}
+
+__attribute__((pure)) static inline float dot2(const v2 vec1, const v2 vec2)
+{
+	return vec1[X] * vec2[X] + vec1[Y] * vec2[Y];
+}
+
+__attribute__((pure)) static inline float dot3(const v3 vec1, const v3 vec2)
+{
+	return vec1[X] * vec2[X] + vec1[Y] * vec2[Y] + vec1[Z] * vec2[Z];
+}
+
+static inline void cross(const v3 vec1, const v3 vec2, v3 result)
+{
+	result[X] = vec1[Y] * vec2[Z] - vec1[Z] * vec2[Y];
+	result[Y] = vec1[Z] * vec2[X] - vec1[X] * vec2[Z];
+	result[Z] = vec1[X] * vec2[Y] - vec1[Y] * vec2[X];
+}
+
+static inline void mul2s(const v2 vec, const float mul, v2 result)
+{
+	result[X] = vec[X] * mul;
+	result[Y] = vec[Y] * mul;
+}
+
+static inline void mul3s(const v3 vec, const float mul, v3 result)
+{
+	result[X] = vec[X] * mul;
+	result[Y] = vec[Y] * mul;
+	result[Z] = vec[Z] * mul;
+}
+
+static inline void mul3v(const v3 vec1, const v3 vec2, v3 result)
+{
+	result[X] = vec1[X] * vec2[X];
+	result[Y] = vec1[Y] * vec2[Y];
+	result[Z] = vec1[Z] * vec2[Z];
+}
+
+static inline void inv3(v3 vec)
+{
+	vec[X] = 1.f / vec[X];
+	vec[Y] = 1.f / vec[Y];
+	vec[Z] = 1.f / vec[Z];
+}
+
+static inline void add2v(const v2 vec1, const v2 vec2, v2 result)
+{
+	result[X] = vec1[X] + vec2[X];
+	result[Y] = vec1[Y] + vec2[Y];
+}
+
+static inline void add2s(const v2 vec1, const float summand, v2 result)
+{
+	result[X] = vec1[X] + summand;
+	result[Y] = vec1[Y] + summand;
+}
+
+static inline void add3v(const v3 vec1, const v3 vec2, v3 result)
+{
+	result[X] = vec1[X] + vec2[X];
+	result[Y] = vec1[Y] + vec2[Y];
+	result[Z] = vec1[Z] + vec2[Z];
+}
+
+static inline void add3s(const v3 vec1, const float summand, v3 result)
+{
+	result[X] = vec1[X] + summand;
+	result[Y] = vec1[Y] + summand;
+	result[Z] = vec1[Z] + summand;
+}
+
+static inline void add3v3(const v3 vec1, const v3 vec2, const v3 vec3, v3 result)
+{
+	result[X] = vec1[X] + vec2[X] + vec3[X];
+	result[Y] = vec1[Y] + vec2[Y] + vec3[Y];
+	result[Z] = vec1[Z] + vec2[Z] + vec3[Z];
+}
+
+static inline void sub2v(const v2 vec1, const v2 vec2, v2 result)
+{
+	result[X] = vec1[X] - vec2[X];
+	result[Y] = vec1[Y] - vec2[Y];
+}
+
+static inline void sub2s(const v2 vec1, const float subtrahend, v2 result)
+{
+	result[X] = vec1[X] - subtrahend;
+	result[Y] = vec1[Y] - subtrahend;
+}
+
+static inline void sub3v(const v3 vec1, const v3 vec2, v3 result)
+{
+	result[X] = vec1[X] - vec2[X];
+	result[Y] = vec1[Y] - vec2[Y];
+	result[Z] = vec1[Z] - vec2[Z];
+}
+
+static inline void sub3s(const v3 vec1, const float subtrahend, v3 result)
+{
+	result[X] = vec1[X] - subtrahend;
+	result[Y] = vec1[Y] - subtrahend;
+	result[Z] = vec1[Z] - subtrahend;
+}
+
+static inline void norm2(v2 vec)
+{
+	mul2s(vec, 1.f / mag2(vec), vec);
+}
+
+static inline void norm3(v3 vec)
+{
+	mul3s(vec, 1.f / mag3(vec), vec);
+}
+
+__attribute__((pure)) static inline float min3(const v3 vec)
+{
+	float min = vec[0];
+	if (min > vec[1])
+		min = vec[1];
+	if (min > vec[2])
+		min = vec[2];
+	return min;
+}
+
+__attribute__((pure)) static inline float max3(const v3 vec)
+{
+	float max = vec[0];
+	if (max < vec[1])
+		max = vec[1];
+	if (max < vec[2])
+		max = vec[2];
+	return max;
+}
+
+__attribute__((const)) static inline float clamp(const float num, const float min, const float max)
+{
+	const float result = num < min ? min : num;
+	return result > max ? max : result;
+}
+
+static inline void clamp3(const v3 vec, const v3 min, const v3 max, v3 result)
+{
+	result[X] = clamp(vec[X], min[X], max[X]);
+	result[Y] = clamp(vec[Y], min[Y], max[Y]);
+	result[Z] = clamp(vec[Z], min[Z], max[Z]);
+}
+
+static inline void mulmv(m3 mat, const float *restrict vec, float *restrict result)
+{
+	result[X] = dot3(mat[X], vec);
+	result[Y] = dot3(mat[Y], vec);
+	result[Z] = dot3(mat[Z], vec);
+}
+
+static inline void mulms(m3 mat, const float mul, m3 result)
+{
+	mul3s(mat[X], mul, result[X]);
+	mul3s(mat[Y], mul, result[Y]);
+	mul3s(mat[Z], mul, result[Z]);
+}
+
+static inline void assign3(v3 dest, const v3 src)
+{
+	dest[X] = src[X];
+	dest[Y] = src[Y];
+	dest[Z] = src[Z];
+}
+
+static inline void assignm(m3 dest, m3 src)
+{
+	assign3(dest[X], src[X]);
+	assign3(dest[Y], src[Y]);
+	assign3(dest[Z], src[Z]);
+}
 
 #endif /* __CALC_H__ */
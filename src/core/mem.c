@@ -11,8 +11,18 @@
 
 #include "mem.h"
 
+#include <stdalign.h>
+#include <stddef.h>
+
 #include "error.h"
 
+struct ArenaBlock {
+	struct ArenaBlock *prev;
+	size_t capacity;
+	size_t used;
+	alignas(max_align_t) unsigned char data[];
+};
+
 void *safe_malloc(const size_t size)
 {
 	void *ptr = malloc(size);
@@ -23,7 +33,7 @@ void *safe_malloc(const size_t size)
 void *safe_realloc(void *ptr, const size_t size)
 {
 	void *new_ptr = realloc(ptr, size);
-	error_check(ptr, "Unable to reallocate [%zu] bytes on heap.", size);
+	error_check(new_ptr, "Unable to reallocate [%zu] bytes on heap.", size);
 	return new_ptr;
 }
 
@@ -33,3 +43,34 @@ void *safe_calloc(const size_t nmemb, const size_t size)
 	error_check(ptr, "Unable to calloc [%zu] bytes on the heap.", nmemb * size);
 	return ptr;
 }
+
+//Allocations are aligned to max_align_t. Ones exceeding ARENA_BLOCK_SIZE get a block of their own
+void *arena_alloc(struct Arena *arena, size_t size)
+{
+	size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+	struct ArenaBlock *block = arena->block;
+	if (!block || block->capacity - block->used < size) {
+		size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+		block = safe_malloc(sizeof(struct ArenaBlock) + capacity);
+		block->capacity = capacity;
+		block->used = 0;
+		block->prev = arena->block;
+		arena->block = block;
+	}
+	void *ptr = block->data + block->used;
+	block->used += size;
+	arena->size += size;
+	return ptr;
+}
+
+void arena_deinit(struct Arena *arena)
+{
+	struct ArenaBlock *block = arena->block;
+	while (block) {
+		struct ArenaBlock *prev = block->prev;
+		free(block);
+		block = prev;
+	}
+	arena->block = NULL;
+	arena->size = 0;
+}
@@ -14,8 +14,20 @@
 
 #include <stdlib.h>
 
+#define ARENA_BLOCK_SIZE (1u << 20)
+
+struct ArenaBlock;
+
+struct Arena { //Bump allocator whose allocations are freed together. Zero-initialized arenas are empty
+	struct ArenaBlock *block;
+	size_t size; //Bytes allocated
+};
+
 void *safe_malloc(size_t size);
 void *safe_realloc(void *ptr, size_t size);
 void *safe_calloc(size_t nmemb, size_t size);
 
+void *arena_alloc(struct Arena *arena, size_t size);
+void arena_deinit(struct Arena *arena);
+
 #endif /* __MEM_H__ */
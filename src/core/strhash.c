@@ -18,3 +18,13 @@ uint32_t hash_djb(const char *cp)
 		hash = 33 * hash ^ (uint8_t)*cp++;
 	return hash;
 }
+
+uint32_t hash_djb_bytes(const void *data, const size_t size)
+{
+	const uint8_t *cp = data;
+	uint32_t hash = 5381;
+	size_t i;
+	for (i = 0; i < size; i++)
+		hash = 33 * hash ^ cp[i];
+	return hash;
+}
@@ -16,5 +16,6 @@
 
 // D. J. Bernstein hash function
 uint32_t hash_djb(const char *cp);
+uint32_t hash_djb_bytes(const void *data, size_t size);
 
 #endif /* __STRHASH_H__ */
@@ -30,13 +30,14 @@ static struct timespec start_t;
 static clock_t start_clock;
 
 static enum LogOption log_option;
+static _Thread_local uint32_t rand_state;
 
 void system_init(void)
 {
 	timespec_get(&start_t, TIME_UTC);
 	start_clock = clock();
 
-	srand((unsigned)start_t.tv_sec);
+	rand_seed((uint32_t)start_t.tv_sec);
 
 	int idx;
 	idx = argv_check_with_args("-p", 1);
@@ -90,7 +91,23 @@ double system_time(void)
 	return 0;
 }
 
+//Seeds the calling thread's generator. Distinct seeds give uncorrelated sequences
+void rand_seed(uint32_t seed)
+{
+	seed ^= seed >> 16;
+	seed *= 0x7feb352du;
+	seed ^= seed >> 15;
+	seed *= 0x846ca68bu;
+	seed ^= seed >> 16;
+	rand_state = seed;
+}
+
+//PCG-RXS-M-XS, uniformly distributed in [0, 1)
 float rand_flt(void)
 {
-	return rand() / (float)RAND_MAX;
+	uint32_t state = rand_state;
+	rand_state = state * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	word = (word >> 22u) ^ word;
+	return (word >> 8) * 0x1p-24f;
 }
@@ -22,6 +22,7 @@
 void system_init(void);
 
 double system_time(void);
+void rand_seed(uint32_t seed);
 float rand_flt(void);
 
 #pragma GCC system_header /* Ignore -Wpedantic warning about ##__VA_ARGS__ trailing comma */
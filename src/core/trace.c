@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2021-2022 Wojciech Graj
+ *
+ * Licensed under the MIT license: https://opensource.org/licenses/MIT
+ * Permission is granted to use, copy, modify, and redistribute the work.
+ * Full license information available in the project LICENSE file.
+ *
+ * DESCRIPTION:
+ *   Timeline of events in Chrome trace format
+ **/
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "argv.h"
+#include "error.h"
+#include "mem.h"
+
+#ifdef MULTITHREADING
+#include <omp.h>
+#endif
+
+struct TraceEvent {
+	char name[32];
+	char detail[96];
+	double start;
+	double end;
+	uint32_t thread;
+};
+
+void trace_fprint_escaped(FILE *file, const char *str);
+
+bool trace_enabled;
+static const char *trace_filename;
+static double trace_origin;
+static struct TraceEvent *events;
+static size_t num_events;
+static size_t max_events;
+
+void trace_init(void)
+{
+	int idx = argv_check_with_args("--trace", 1);
+	if (!idx)
+		return;
+	trace_filename = myargv[idx + 1];
+	trace_enabled = true;
+	trace_origin = trace_time();
+	max_events = 1024;
+	events = safe_malloc(sizeof(struct TraceEvent) * max_events);
+}
+
+void trace_fprint_escaped(FILE *file, const char *str)
+{
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fputc('\\', file);
+		fputc(*str, file);
+	}
+}
+
+void trace_deinit(void)
+{
+	if (!trace_enabled)
+		return;
+
+	printf_log("Saving trace.");
+
+	FILE *file = fopen(trace_filename, "w");
+	error_check(file, "Failed to open trace file [%s].", trace_filename);
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+	size_t i;
+	for (i = 0; i < num_events; i++) {
+		struct TraceEvent *event = &events[i];
+		fputs("{\"name\":\"", file);
+		trace_fprint_escaped(file, event->name);
+		fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", event->thread, (event->start - trace_origin) * 1e6, (event->end - event->start) * 1e6);
+		if (event->detail[0]) {
+			fputs(",\"args\":{\"detail\":\"", file);
+			trace_fprint_escaped(file, event->detail);
+			fputs("\"}", file);
+		}
+		fputs(i + 1 < num_events ? "},\n" : "}\n", file);
+	}
+	fputs("]}\n", file);
+	fclose(file);
+
+	free(events);
+	trace_enabled = false;
+}
+
+double trace_time(void)
+{
+	struct timespec t;
+	timespec_get(&t, TIME_UTC);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+void trace_event(const char *name, const char *detail, const double start)
+{
+	if (!trace_enabled)
+		return;
+
+	struct TraceEvent event = {
+		.start = start,
+		.end = trace_time(),
+#ifdef MULTITHREADING
+		.thread = omp_get_thread_num(),
+#endif
+	};
+	strncpy(event.name, name, sizeof(event.name) - 1);
+	if (detail)
+		strncpy(event.detail, detail, sizeof(event.detail) - 1);
+
+#ifdef MULTITHREADING
+#pragma omp critical(trace)
+#endif
+	{
+		if (num_events == max_events) {
+			max_events *= 2;
+			events = safe_realloc(events, sizeof(struct TraceEvent) * max_events);
+		}
+		events[num_events++] = event;
+	}
+}
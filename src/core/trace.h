@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2021-2022 Wojciech Graj
+ *
+ * Licensed under the MIT license: https://opensource.org/licenses/MIT
+ * Permission is granted to use, copy, modify, and redistribute the work.
+ * Full license information available in the project LICENSE file.
+ *
+ * DESCRIPTION:
+ *   Timeline of events in Chrome trace format
+ **/
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "type.h"
+
+/* Enabled with --trace <filename>. Requires argv_init to be called */
+void trace_init(void);
+/* Writes trace file */
+void trace_deinit(void);
+
+/* Timestamp to pass to trace_event as the start of an event */
+double trace_time(void);
+/* Record an event on the calling thread which ends now. Does nothing if tracing is disabled. Thread-safe */
+void trace_event(const char *name, const char *detail, double start);
+
+extern bool trace_enabled;
+
+#endif /* __TRACE_H__ */
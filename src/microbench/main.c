@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2021-2022 Wojciech Graj
+ *
+ * Licensed under the MIT license: https://opensource.org/licenses/MIT
+ * Permission is granted to use, copy, modify, and redistribute the work.
+ * Full license information available in the project LICENSE file.
+ *
+ * DESCRIPTION:
+ *   Microbenchmarks of ray-primitive intersection kernels and BVH traversal
+ **/
+
+#define _GNU_SOURCE /* sched_setaffinity, clock_gettime */
+
+#include <float.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "accel.h"
+#include "argv.h"
+#include "calc.h"
+#include "camera.h"
+#include "error.h"
+#include "material.h"
+#include "mem.h"
+#include "object.h"
+#include "render.h"
+#include "scene.h"
+#include "stats.h"
+#include "system.h"
+
+#define NUM_RAYS 4096
+#define NUM_PRIMITIVES 256
+#define NUM_SCENE_TRIANGLES 100000
+#define NUM_RUNS 7
+#define BVH_PACKET_RAYS 16
+#define SECONDARY_RAYS_PER_HIT 4
+#define SECONDARY_BATCH_RAYS 4096 //Path tracing rays of a row of pixels with a few samples each
+
+struct Kernel {
+	const char *name;
+	uint64_t (*run)(void);
+	size_t tests_per_run;
+};
+
+static const char *HELPTEXT =
+	"Microbenchmark ray-primitive intersection kernels and BVH traversal.\n"
+	"Copyright: (c) 2021-2022 Wojciech Graj\n"
+	"License: https://opensource.org/licenses/MIT\n"
+	"\n"
+	"Usage: ./microbenchmark [<input> <resolution>] [OPTIONAL_PARAMETERS]\n"
+	"\n"
+	"OPTIONAL PARAMETERS:\n"
+	"<input>      (string)            : .json scene from which primary rays are recorded. A random triangle soup is used if omitted.\n"
+	"<resolution> (integer) (integer) : number of primary rays recorded from scene.\n"
+	"[-c] (integer)                   : DEFAULT = 0       : CPU to which the benchmark is pinned.\n";
+
+int main(int argc, char *argv[]);
+double time_now(void);
+void random_point(v3 point, float scale);
+void random_ray(struct Ray *ray);
+void primitives_init(void);
+void random_scene_init(void);
+void scene_rays_init(void);
+void secondary_rays_init(void);
+int key_compare(const void *p1, const void *p2);
+void kernel_benchmark(const struct Kernel *kernel);
+uint64_t run_sphere(void);
+uint64_t run_triangle(void);
+uint64_t run_plane(void);
+uint64_t run_bounding_cuboid(void);
+uint64_t run_bvh_closest(void);
+uint64_t run_bvh_packet_closest(void);
+uint64_t run_bvh_light_blocked(void);
+uint64_t run_bvh_secondary(void);
+uint64_t run_bvh_secondary_sorted(void);
+
+static struct Ray rays[NUM_RAYS];
+static v3 sphere_positions[NUM_PRIMITIVES];
+static float sphere_radii[NUM_PRIMITIVES];
+static v3 triangle_vertices[NUM_PRIMITIVES][3];
+static struct Object *planes[NUM_PRIMITIVES];
+static struct BoundingCuboid *bounding_cuboids[NUM_PRIMITIVES];
+static struct Ray *bvh_rays;
+static size_t num_bvh_rays;
+static struct Ray *secondary_rays; //In the order in which depth-first path tracing casts them
+static size_t num_secondary_rays;
+static struct Ray secondary_batch[SECONDARY_BATCH_RAYS];
+static uint64_t secondary_batch_keys[SECONDARY_BATCH_RAYS];
+static struct Material random_scene_material;
+static volatile float sink; //Prevents results from being optimized away
+
+double time_now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//Uniformly distributed in [0, scale)^3
+void random_point(v3 point, const float scale)
+{
+	point[X] = rand_flt() * scale;
+	point[Y] = rand_flt() * scale;
+	point[Z] = rand_flt() * scale;
+}
+
+//Ray from outside the unit cube towards a point inside it
+void random_ray(struct Ray *ray)
+{
+	v3 target;
+	random_point(target, 1.f);
+	float inclination = acosf(rand_flt() * 2.f - 1.f);
+	float azimuth = rand_flt() * 2.f * PI;
+	v3 offset = SPHERICAL_TO_CARTESIAN(3.f, inclination, azimuth);
+	add3v(target, offset, ray->point);
+	mul3s(offset, -1.f / 3.f, ray->direction);
+}
+
+void primitives_init(void)
+{
+	size_t i;
+	for (i = 0; i < NUM_RAYS; i++)
+		random_ray(&rays[i]);
+
+	for (i = 0; i < NUM_PRIMITIVES; i++) {
+		random_point(sphere_positions[i], 1.f);
+		sphere_radii[i] = .01f + rand_flt() * .05f;
+
+		random_point(triangle_vertices[i][0], 1.f);
+		random_point(triangle_vertices[i][1], .1f);
+		random_point(triangle_vertices[i][2], .1f);
+		sub3s(triangle_vertices[i][1], .05f, triangle_vertices[i][1]);
+		sub3s(triangle_vertices[i][2], .05f, triangle_vertices[i][2]);
+		add3v(triangle_vertices[i][0], triangle_vertices[i][1], triangle_vertices[i][1]);
+		add3v(triangle_vertices[i][0], triangle_vertices[i][2], triangle_vertices[i][2]);
+
+		v3 position, normal;
+		random_point(position, 1.f);
+		random_point(normal, 1.f);
+		sub3s(normal, .5f, normal);
+		planes[i] = plane_new(position, normal);
+		object_init(planes[i], NULL, 1.e-6f, 0, OBJECT_PLANE);
+
+		v3 corners[2];
+		random_point(corners[0], 1.f);
+		random_point(corners[1], .1f);
+		add3v(corners[0], corners[1], corners[1]);
+		bounding_cuboids[i] = bounding_cuboid_new(0.f, corners);
+	}
+}
+
+void random_scene_init(void)
+{
+	printf_log("Generating %u random triangles.", NUM_SCENE_TRIANGLES);
+
+	num_objects = NUM_SCENE_TRIANGLES;
+	num_emittant_objects = 0;
+	num_unbound_objects = 0;
+	objects_init();
+
+	size_t i;
+	for (i = 0; i < num_objects; i++) {
+		v3 vertices[3];
+		random_point(vertices[0], 1.f);
+		random_point(vertices[1], .02f);
+		random_point(vertices[2], .02f);
+		add3v(vertices[0], vertices[1], vertices[1]);
+		add3v(vertices[0], vertices[2], vertices[2]);
+		objects[i] = triangle_new(vertices);
+		object_init(objects[i], &random_scene_material, -1.f, 0, OBJECT_TRIANGLE);
+		objects[i]->object_data->postinit(objects[i]);
+	}
+
+	num_bvh_rays = NUM_RAYS;
+	bvh_rays = safe_malloc(sizeof(struct Ray) * num_bvh_rays);
+	for (i = 0; i < num_bvh_rays; i++)
+		random_ray(&bvh_rays[i]);
+}
+
+//Records the primary rays which the raytracer would cast through pixel centers
+void scene_rays_init(void)
+{
+	scene_load();
+
+	uint32_t resolution[2] = { abs(atoi(myargv[2])), abs(atoi(myargv[3])) };
+	v2 size;
+	size[X] = 2.f * tanf(camera.fov * PI / 360.f);
+	size[Y] = size[X] * resolution[Y] / resolution[X];
+
+	num_bvh_rays = resolution[X] * resolution[Y];
+	bvh_rays = safe_malloc(sizeof(struct Ray) * num_bvh_rays);
+	uint32_t row, col;
+	size_t i = 0;
+	for (row = 0; row < resolution[Y]; row++) {
+		for (col = 0; col < resolution[X]; col++) {
+			v3 offset_x, offset_y;
+			mul3s(camera.vectors[X], ((col + .5f) / resolution[X] - .5f) * size[X], offset_x);
+			mul3s(camera.vectors[Y], ((row + .5f) / resolution[Y] - .5f) * size[Y], offset_y);
+			add3v3(camera.vectors[Z], offset_x, offset_y, bvh_rays[i].direction);
+			norm3(bvh_rays[i].direction);
+			assign3(bvh_rays[i].point, camera.position);
+			i++;
+		}
+	}
+}
+
+//Diffusely reflected rays leaving the closest intersections of bvh_rays
+void secondary_rays_init(void)
+{
+	secondary_rays = safe_malloc(sizeof(struct Ray) * num_bvh_rays * SECONDARY_RAYS_PER_HIT);
+	size_t i, j;
+	for (i = 0; i < num_bvh_rays; i++) {
+		struct Object *object = NULL;
+		v3 normal;
+		float distance = FLT_MAX;
+		accel_get_closest_intersection(&bvh_rays[i], &object, normal, &distance);
+		if (!object)
+			continue;
+		if (dot3(normal, bvh_rays[i].direction) > 0.f)
+			mul3s(normal, -1.f, normal);
+		v3 point, offset;
+		mul3s(bvh_rays[i].direction, distance, point);
+		add3v(point, bvh_rays[i].point, point);
+		mul3s(normal, 1e-4f, offset);
+		add3v(point, offset, point);
+		for (j = 0; j < SECONDARY_RAYS_PER_HIT; j++) {
+			struct Ray *ray = &secondary_rays[num_secondary_rays++];
+			float inclination = acosf(rand_flt() * 2.f - 1.f);
+			float azimuth = rand_flt() * 2.f * PI;
+			v3 direction = SPHERICAL_TO_CARTESIAN(1.f, inclination, azimuth);
+			if (dot3(direction, normal) < 0.f)
+				mul3s(direction, -1.f, direction);
+			assign3(ray->direction, direction);
+			assign3(ray->point, point);
+			ray->time = 0.f;
+		}
+	}
+	ray_sort_init();
+}
+
+int key_compare(const void *p1, const void *p2)
+{
+	uint64_t key1 = *(const uint64_t *)p1, key2 = *(const uint64_t *)p2;
+	return (key1 > key2) - (key1 < key2);
+}
+
+uint64_t run_sphere(void)
+{
+	uint64_t hits = 0;
+	float distance_sum = 0.f;
+	size_t i, j;
+	for (i = 0; i < NUM_RAYS; i++)
+		for (j = 0; j < NUM_PRIMITIVES; j++) {
+			float distance;
+			if (line_intersects_sphere(sphere_positions[j], sphere_radii[j], rays[i].point, rays[i].direction, 1.e-4f, &distance)) {
+				hits++;
+				distance_sum += distance;
+			}
+		}
+	sink = distance_sum;
+	return hits;
+}
+
+uint64_t run_triangle(void)
+{
+	uint64_t hits = 0;
+	float distance_sum = 0.f;
+	size_t i, j;
+	for (i = 0; i < NUM_RAYS; i++)
+		for (j = 0; j < NUM_PRIMITIVES; j++) {
+			float distance;
+			if (line_intersects_triangle(triangle_vertices[j], rays[i].point, rays[i].direction, &distance)) {
+				hits++;
+				distance_sum += distance;
+			}
+		}
+	sink = distance_sum;
+	return hits;
+}
+
+uint64_t run_plane(void)
+{
+	uint64_t hits = 0;
+	float distance_sum = 0.f;
+	size_t i, j;
+	for (i = 0; i < NUM_RAYS; i++)
+		for (j = 0; j < NUM_PRIMITIVES; j++) {
+			float distance;
+			v3 normal;
+			if (plane_get_intersection(planes[j], &rays[i], &distance, normal)) {
+				hits++;
+				distance_sum += distance;
+			}
+		}
+	sink = distance_sum;
+	return hits;
+}
+
+uint64_t run_bounding_cuboid(void)
+{
+	uint64_t hits = 0;
+	float distance_sum = 0.f;
+	size_t i, j;
+	for (i = 0; i < NUM_RAYS; i++)
+		for (j = 0; j < NUM_PRIMITIVES; j++) {
+			float tmin, tmax;
+			if (bounding_cuboid_intersects(bounding_cuboids[j], &rays[i], &tmax, &tmin)) {
+				hits++;
+				distance_sum += tmin;
+			}
+		}
+	sink = distance_sum;
+	return hits;
+}
+
+uint64_t run_bvh_closest(void)
+{
+	uint64_t hits = 0;
+	float distance_sum = 0.f;
+	size_t i;
+	for (i = 0; i < num_bvh_rays; i++) {
+		struct Object *object = NULL;
+		v3 normal;
+		float distance = FLT_MAX;
+		accel_get_closest_intersection(&bvh_rays[i], &object, normal, &distance);
+		if (object) {
+			hits++;
+			distance_sum += distance;
+		}
+	}
+	sink = distance_sum;
+	return hits;
+}
+
+//Consecutive rays are traced together, which are adjacent pixels of a row in scene mode
+uint64_t run_bvh_packet_closest(void)
+{
+	uint64_t hits = 0;
+	float distance_sum = 0.f;
+	size_t i, j;
+	for (i = 0; i < num_bvh_rays; i += BVH_PACKET_RAYS) {
+		size_t num_rays = MIN(BVH_PACKET_RAYS, num_bvh_rays - i);
+		struct Object *closest_objects[BVH_PACKET_RAYS] = { NULL };
+		v3 normals[BVH_PACKET_RAYS];
+		float distances[BVH_PACKET_RAYS];
+		for (j = 0; j < num_rays; j++)
+			distances[j] = FLT_MAX;
+		accel_get_closest_intersections(&bvh_rays[i], num_rays, closest_objects, normals, distances);
+		for (j = 0; j < num_rays; j++) {
+			if (closest_objects[j]) {
+				hits++;
+				distance_sum += distances[j];
+			}
+		}
+	}
+	sink = distance_sum;
+	return hits;
+}
+
+uint64_t run_bvh_light_blocked(void)
+{
+	uint64_t hits = 0;
+	size_t i;
+	for (i = 0; i < num_bvh_rays; i++) {
+		v3 light_intensity = { 1.f, 1.f, 1.f };
+		hits += accel_is_light_blocked(&bvh_rays[i], FLT_MAX, light_intensity, NULL);
+	}
+	return hits;
+}
+
+uint64_t run_bvh_secondary(void)
+{
+	uint64_t hits = 0;
+	float distance_sum = 0.f;
+	size_t i;
+	for (i = 0; i < num_secondary_rays; i++) {
+		struct Object *object = NULL;
+		v3 normal;
+		float distance = FLT_MAX;
+		accel_get_closest_intersection(&secondary_rays[i], &object, normal, &distance);
+		if (object) {
+			hits++;
+			distance_sum += distance;
+		}
+	}
+	sink = distance_sum;
+	return hits;
+}
+
+//Includes the cost of sorting each batch by ray_sort_key, like --sort-rays
+uint64_t run_bvh_secondary_sorted(void)
+{
+	uint64_t hits = 0;
+	float distance_sum = 0.f;
+	size_t i, j;
+	for (i = 0; i < num_secondary_rays; i += SECONDARY_BATCH_RAYS) {
+		size_t num_rays = MIN(SECONDARY_BATCH_RAYS, num_secondary_rays - i);
+		memcpy(secondary_batch, &secondary_rays[i], sizeof(struct Ray) * num_rays);
+		for (j = 0; j < num_rays; j++)
+			secondary_batch_keys[j] = (uint64_t)ray_sort_key(&secondary_batch[j]) << 32 | j;
+		qsort(secondary_batch_keys, num_rays, sizeof(uint64_t), &key_compare);
+		for (j = 0; j < num_rays; j++) {
+			struct Object *object = NULL;
+			v3 normal;
+			float distance = FLT_MAX;
+			accel_get_closest_intersection(&secondary_batch[(uint32_t)secondary_batch_keys[j]], &object, normal, &distance);
+			if (object) {
+				hits++;
+				distance_sum += distance;
+			}
+		}
+	}
+	sink = distance_sum;
+	return hits;
+}
+
+//Reports fastest of NUM_RUNS runs following a warmup run
+void kernel_benchmark(const struct Kernel *kernel)
+{
+	uint64_t hits = kernel->run();
+	double best = DBL_MAX;
+	unsigned i;
+	for (i = 0; i < NUM_RUNS; i++) {
+		double start = time_now();
+		kernel->run();
+		double elapsed = time_now() - start;
+		if (elapsed < best)
+			best = elapsed;
+	}
+	double ns_per_test = best * 1e9 / kernel->tests_per_run;
+	printf("%-26s %10zu tests %8.2f%% hit %10.3f ns/test %10.2f Mtests/s\n",
+		kernel->name, kernel->tests_per_run, 100. * hits / kernel->tests_per_run, ns_per_test, 1e3 / ns_per_test);
+#if defined(STATISTICS) && defined(CACHE_SIMULATION)
+	//One more run through the simulated caches, which were warmed up by the runs above
+	uint64_t accesses = stats_local[STAT_CACHE_ACCESSES], l1_misses = stats_local[STAT_L1_MISSES], l2_misses = stats_local[STAT_L2_MISSES];
+	kernel->run();
+	printf("%-26s %10.3f accesses/test %10.3f L1 misses/test %10.3f L2 misses/test\n", "", (double)(stats_local[STAT_CACHE_ACCESSES] - accesses) / kernel->tests_per_run,
+		(double)(stats_local[STAT_L1_MISSES] - l1_misses) / kernel->tests_per_run, (double)(stats_local[STAT_L2_MISSES] - l2_misses) / kernel->tests_per_run);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+	myargc = argc;
+	myargv = argv;
+	argv_init();
+
+	if (argv_check("--help") || argv_check("-h")) {
+		puts(HELPTEXT);
+		return 0;
+	}
+
+	system_init();
+	rand_seed(0);
+
+	int idx = argv_check_with_args("-c", 1);
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(idx ? abs(atoi(myargv[idx + 1])) : 0, &cpu_set);
+	if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set))
+		printf_log("Failed to pin benchmark to CPU.");
+
+	primitives_init();
+	if (argc >= 4 && myargv[ARG_INPUT_FILENAME][0] != '-')
+		scene_rays_init();
+	else
+		random_scene_init();
+	accel_init();
+	secondary_rays_init();
+
+	const struct Kernel kernels[] = {
+		{ "line_intersects_sphere", &run_sphere, NUM_RAYS * NUM_PRIMITIVES },
+		{ "line_intersects_triangle", &run_triangle, NUM_RAYS * NUM_PRIMITIVES },
+		{ "plane_get_intersection", &run_plane, NUM_RAYS * NUM_PRIMITIVES },
+		{ "bounding_cuboid_intersects", &run_bounding_cuboid, NUM_RAYS * NUM_PRIMITIVES },
+		{ "bvh closest intersection", &run_bvh_closest, num_bvh_rays },
+		{ "bvh packet closest", &run_bvh_packet_closest, num_bvh_rays },
+		{ "bvh light blocked", &run_bvh_light_blocked, num_bvh_rays },
+		{ "bvh secondary depth-first", &run_bvh_secondary, num_secondary_rays },
+		{ "bvh secondary sorted", &run_bvh_secondary_sorted, num_secondary_rays },
+	};
+
+	printf_log("Running kernels.");
+	size_t i;
+	for (i = 0; i < arrlen(kernels); i++)
+		kernel_benchmark(&kernels[i]);
+
+	free(bvh_rays);
+	free(secondary_rays);
+	accel_deinit(); //Also frees bounding_cuboids
+	objects_deinit(); //Also frees planes
+	argv_deinit();
+}
@@ -24,9 +24,29 @@
 #include <tiffio.h>
 
 #define TIFFTAG_Z_BUFFER 65000
+#define TIFFTAG_NORMAL_BUFFER 65001
+#define TIFFTAG_ALBEDO_BUFFER 65002
+#define TIFFTAG_MATERIAL_BUFFER 65003
+#define TIFFTAG_OBJECT_BUFFER 65004
+#define TIFFTAG_RAY_COUNT_BUFFER 65005
+
+void *image_load_aov(TIFF *tif, uint32_t tag, size_t size);
 
 struct Image image;
 
+/* Returns NULL if tag is absent */
+void *image_load_aov(TIFF *tif, const uint32_t tag, const size_t size)
+{
+	uint32_t count;
+	void *data;
+	if (!TIFFGetField(tif, tag, &count, &data))
+		return NULL;
+	error_check((size_t)count * 4 == image.pixels * size, "Corrupted auxiliary buffer [%u].", tag);
+	void *buffer = safe_malloc(image.pixels * size);
+	memcpy(buffer, data, image.pixels * size);
+	return buffer;
+}
+
 void image_load(void)
 {
 	printf_log("Loading image.");
@@ -69,6 +89,14 @@ void image_load(void)
 	error_check(count == image.pixels, "Corrupted Z-Buffer.");
 	memcpy(image.z_buffer, z_buffer, image.pixels * sizeof(float));
 
+	image.normal_buffer = image_load_aov(tif, TIFFTAG_NORMAL_BUFFER, sizeof(v3));
+	image.albedo_buffer = image_load_aov(tif, TIFFTAG_ALBEDO_BUFFER, sizeof(v3));
+	image.material_buffer = image_load_aov(tif, TIFFTAG_MATERIAL_BUFFER, sizeof(int32_t));
+	image.object_buffer = image_load_aov(tif, TIFFTAG_OBJECT_BUFFER, sizeof(int32_t));
+	image.ray_count_buffer = image_load_aov(tif, TIFFTAG_RAY_COUNT_BUFFER, sizeof(uint32_t));
+	if (image.normal_buffer)
+		printf_log("Loaded auxiliary buffers.");
+
 	TIFFClose(tif);
 }
 
@@ -76,6 +104,11 @@ void image_deinit(void)
 {
 	free(image.raster);
 	free(image.z_buffer);
+	free(image.normal_buffer);
+	free(image.albedo_buffer);
+	free(image.material_buffer);
+	free(image.object_buffer);
+	free(image.ray_count_buffer);
 }
 
 void save_image(void)
@@ -20,6 +20,13 @@ struct Image {
 
 	v3 *raster;
 	float *z_buffer;
+
+	/* Auxiliary buffers saved by raytracer with --aov. NULL if absent */
+	v3 *normal_buffer;
+	v3 *albedo_buffer;
+	int32_t *material_buffer;
+	int32_t *object_buffer;
+	uint32_t *ray_count_buffer;
 };
 
 void image_load(void);
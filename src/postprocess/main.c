@@ -27,6 +27,11 @@ static const char *HELPTEXT =
 	"<input>      (string)            : .tif raw file created by raytracer.\n"
 	"<output>     (string)            : .tif file to which the image will be saved.\n"
 	"OPTIONAL PARAMETERS:\n"
+	"[--aov-view] <buffer>            : Replace image with an auxiliary buffer (requires raytracer --aov).\n"
+	"  <buffer> (\"normal\"|\"albedo\"|\"material\"|\"object\"|\"rays\") : \n"
+	"[--denoise] <radius> <sigma>     : Apply edge-preserving filter guided by auxiliary buffers (requires raytracer --aov).\n"
+	"  <radius> (integer)             : Filter radius in pixels.\n"
+	"  <sigma> (float)                : Tolerance to normal, albedo, and depth differences.\n"
 	"[-b] (float)                     : DEFAULT = 1.0     : brighten.\n"
 	"[--dof] <scale> <bias>           : Apply depth of field effect (incompatible with --dof-camera).\n"
 	"  <scale> (float)                : \n"
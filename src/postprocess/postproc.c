@@ -29,15 +29,60 @@ enum Falloff {
 	FALLOFF_INV_QUADRATIC,
 };
 
+enum AOV {
+	AOV_NORMAL,
+	AOV_ALBEDO,
+	AOV_MATERIAL,
+	AOV_OBJECT,
+	AOV_RAY_COUNT,
+};
+
 void brighten(float factor);
 void depth_of_field(float scale, float bias);
 void mist(float start, float depth, enum Falloff falloff, const v3 color);
+void denoise(int radius, float sigma);
+void view_aov(enum AOV aov);
+void id_to_color(int32_t id, v3 color);
 
 void postprocess(void)
 {
 	printf_log("Commencing Postprocessing");
 
 	int idx;
+	idx = argv_check_with_args("--aov-view", 1);
+	if (idx) {
+		enum AOV aov;
+		switch (hash_myargv[idx + 1]) {
+		case 1648243766u: //normal
+			aov = AOV_NORMAL;
+			break;
+		case 1313378404u: //albedo
+			aov = AOV_ALBEDO;
+			break;
+		case 1473637390u: //material
+			aov = AOV_MATERIAL;
+			break;
+		case 1687850384u: //object
+			aov = AOV_OBJECT;
+			break;
+		case 2088307132u: //rays
+			aov = AOV_RAY_COUNT;
+			break;
+		default:
+			error("Unrecognized auxiliary buffer [%s].", myargv[idx + 1]);
+		}
+		view_aov(aov);
+	}
+
+	idx = argv_check_with_args("--denoise", 2);
+	if (idx) {
+		int radius = atoi(myargv[idx + 1]);
+		float sigma = atof(myargv[idx + 2]);
+		error_check(radius >= 0, "Denoising radius must not be negative but got [%d].", radius);
+		error_check(sigma > 0.f, "Denoising sigma must be positive but got [%f].", (double)sigma);
+		denoise(radius, sigma);
+	}
+
 	idx = argv_check_with_args("-b", 1);
 	if (idx) {
 		float factor = atof(myargv[idx + 1]);
@@ -186,3 +231,98 @@ void mist(const float start, const float depth, const enum Falloff falloff, cons
 		add3v(image.raster[i], adj_mist, image.raster[i]);
 	}
 }
+
+//Cross-bilateral filter guided by the normal, albedo, and depth buffers
+void denoise(const int radius, const float sigma)
+{
+	printf_log("Denoising with radius [%d] and sigma [%f].", radius, (double)sigma);
+
+	error_check(image.normal_buffer && image.albedo_buffer, "Denoising requires auxiliary buffers. Render with --aov.");
+
+	v3 *raster = safe_malloc(image.pixels * sizeof(v3));
+	const float inv_sigma_sqr = 1.f / sqr(sigma);
+	const float inv_radius_sqr = 2.f / sqr(radius + 1);
+
+	size_t i;
+	for (i = 0; i < image.pixels; i++) {
+		const int cx = i % image.resolution[X];
+		const int cy = i / image.resolution[X];
+		const float depth = image.z_buffer[i];
+		v3 sum = { 0.f, 0.f, 0.f };
+		float weight_sum = 0.f;
+		int x, y;
+		for (y = MAX(cy - radius, 0); y <= MIN(cy + radius, (int)image.resolution[Y] - 1); y++) {
+			for (x = MAX(cx - radius, 0); x <= MIN(cx + radius, (int)image.resolution[X] - 1); x++) {
+				const size_t idx = x + y * image.resolution[X];
+				v3 delta_normal, delta_albedo;
+				sub3v(image.normal_buffer[idx], image.normal_buffer[i], delta_normal);
+				sub3v(image.albedo_buffer[idx], image.albedo_buffer[i], delta_albedo);
+				const float delta_depth = depth > 0.f ? (image.z_buffer[idx] - depth) / depth : image.z_buffer[idx];
+				const float weight = expf(-(sqr(x - cx) + sqr(y - cy)) * inv_radius_sqr
+					- (magsqr3(delta_normal) + magsqr3(delta_albedo) + sqr(delta_depth)) * inv_sigma_sqr);
+				v3 weighted;
+				mul3s(image.raster[idx], weight, weighted);
+				add3v(sum, weighted, sum);
+				weight_sum += weight;
+			}
+		}
+		mul3s(sum, 1.f / weight_sum, raster[i]);
+	}
+
+	free(image.raster);
+	image.raster = raster;
+}
+
+void id_to_color(const int32_t id, v3 color)
+{
+	if (id < 0) {
+		color[X] = color[Y] = color[Z] = 0.f;
+		return;
+	}
+	uint32_t hash = (uint32_t)id * 2654435761u;
+	color[X] = .2f + .8f * (hash & 0xFFu) / 255.f;
+	color[Y] = .2f + .8f * ((hash >> 8) & 0xFFu) / 255.f;
+	color[Z] = .2f + .8f * ((hash >> 16) & 0xFFu) / 255.f;
+}
+
+//Replaces the raster with a visualization of an auxiliary buffer
+void view_aov(const enum AOV aov)
+{
+	printf_log("Viewing auxiliary buffer.");
+
+	uint32_t max_ray_count = 1;
+	size_t i;
+	switch (aov) {
+	case AOV_NORMAL:
+		error_check(image.normal_buffer, "Missing normal buffer. Render with --aov.");
+		for (i = 0; i < image.pixels; i++) {
+			mul3s(image.normal_buffer[i], .5f, image.raster[i]);
+			add3s(image.raster[i], .5f, image.raster[i]);
+		}
+		break;
+	case AOV_ALBEDO:
+		error_check(image.albedo_buffer, "Missing albedo buffer. Render with --aov.");
+		memcpy(image.raster, image.albedo_buffer, image.pixels * sizeof(v3));
+		break;
+	case AOV_MATERIAL:
+		error_check(image.material_buffer, "Missing material buffer. Render with --aov.");
+		for (i = 0; i < image.pixels; i++)
+			id_to_color(image.material_buffer[i], image.raster[i]);
+		break;
+	case AOV_OBJECT:
+		error_check(image.object_buffer, "Missing object buffer. Render with --aov.");
+		for (i = 0; i < image.pixels; i++)
+			id_to_color(image.object_buffer[i], image.raster[i]);
+		break;
+	case AOV_RAY_COUNT:
+		error_check(image.ray_count_buffer, "Missing ray count buffer. Render with --aov.");
+		for (i = 0; i < image.pixels; i++)
+			if (image.ray_count_buffer[i] > max_ray_count)
+				max_ray_count = image.ray_count_buffer[i];
+		for (i = 0; i < image.pixels; i++) {
+			const float val = image.ray_count_buffer[i] / (float)max_ray_count;
+			image.raster[i][X] = image.raster[i][Y] = image.raster[i][Z] = val;
+		}
+		break;
+	}
+}
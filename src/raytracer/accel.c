@@ -16,10 +16,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "argv.h"
 #include "calc.h"
+#include "error.h"
 #include "material.h"
 #include "mem.h"
 #include "object.h"
+#include "stats.h"
 #include "system.h"
 
 struct BoundingCuboid {
@@ -36,6 +39,8 @@ union BVHChild {
 
 struct BVH {
 	bool is_leaf;
+	bool is_animated; //Contains animated objects
+	float area; //Surface area of bounding cuboid when node was built. Only set for internal nodes
 	struct BoundingCuboid *bounding_cuboid;
 	union BVHChild children[];
 };
@@ -45,27 +50,142 @@ struct BVHWithMorton { //Only used when constructing BVH tree
 	struct BVH *bvh;
 };
 
+#define SBVH_NUM_BINS 32
+#define SBVH_MIN_OVERLAP 1e-5f //Spatial splits are only attempted if children of the best object split overlap by this fraction of the root's surface area
+#define ACCEL_MAX_TRANSPARENT_HITS 16
+
+struct BVHReference { //Only used when constructing SBVH
+	struct Object *object;
+	struct BoundingCuboid cuboid; //Bounds of the part of the object assigned to this reference
+};
+
+struct SBVHBin {
+	struct BoundingCuboid cuboid;
+	size_t num_entries; //References whose centroid (object split) or lower bound (spatial split) is in bin
+	size_t num_exits; //References whose upper bound is in bin
+};
+
+struct SBVHSplit {
+	float cost;
+	uint32_t axis;
+	bool is_spatial;
+	size_t bin; //Index of last bin of left child for object splits
+	float position; //Plane of spatial split
+	struct BoundingCuboid cuboids[2];
+	size_t num_references[2];
+};
+
+struct RayPacket { //Rays whose directions have the same sign along each axis
+	const struct Ray *rays;
+	size_t num_rays;
+	v3 inverse_directions[ACCEL_MAX_PACKET_RAYS];
+	size_t near_corner[3]; //Index of corner of cuboids which rays enter through along each axis
+	v3 point_bounds[2]; //Bounds of origins and inverse directions of all rays
+	v3 inverse_direction_bounds[2];
+};
+
+#ifdef QUANTIZED_BVH
+#if QUANTIZED_BVH == 16
+typedef uint16_t qbvh_bound_t;
+#define QBVH_MAX_BOUND 65535.f
+#else
+typedef uint8_t qbvh_bound_t;
+#define QBVH_MAX_BOUND 255.f
+#endif
+
+#define QBVH_LEAF 0x80000000u //Set in child reference if it indexes qbvh_leaves rather than qbvh_nodes
+
+struct QBVHNode { //Bounds of children are stored relative to the bounds of the node, rounded outwards
+	v3 origin;
+	v3 scale;
+	float epsilon[2];
+	qbvh_bound_t bounds[2][2][3]; //[child][min/max][axis]
+	uint32_t children[2];
+};
+#endif
+
 /* Helper Funcs */
 uint32_t expand_bits(uint32_t num);
-uint32_t morton_code(const v3 vec);
 
 /* BoundingCuboid */
-struct BoundingCuboid *bounding_cuboid_new(float epsilon, v3 corners[2]);
+struct BoundingCuboid *bvh_bounding_cuboid_new(float epsilon, v3 corners[2]);
 struct BoundingCuboid *bounding_cuboid_new_from_object(const struct Object *object);
-void bounding_cuboid_delete(struct BoundingCuboid *bounding_cuboid);
-bool bounding_cuboid_intersects(const struct BoundingCuboid *cuboid, const struct Ray *ray, float *tmax, float *tmin);
 
 /* BVH */
 struct BVH *bvh_new(bool is_leaf, const struct BoundingCuboid *bounding_cuboid);
 int bvh_morton_code_compare(const void *p1, const void *p2);
 struct BoundingCuboid *bvh_generate_bounding_cuboid_leaf(const struct BVHWithMorton *leaf_array, size_t first, size_t last);
 struct BoundingCuboid *bvh_generate_bounding_cuboid_node(const struct BVH *bvh_left, const struct BVH *bvh_right);
+void bounding_cuboid_merge(const struct BoundingCuboid *left, const struct BoundingCuboid *right, struct BoundingCuboid *cuboid);
+size_t bvh_find_split(const struct BVHWithMorton *leaf_array, size_t first, size_t last);
 struct BVH *bvh_generate_node(const struct BVHWithMorton *leaf_array, size_t first, size_t last);
-void bvh_delete(struct BVH *bvh);
 void bvh_get_closest_intersection(const struct BVH *bvh, const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance);
 bool bvh_is_light_blocked(const struct BVH *bvh, const struct Ray *ray, float distance, v3 light_intensity, const struct Object *emittant_object);
+bool ray_packet_init(struct RayPacket *packet, const struct Ray *rays, size_t num_rays);
+bool ray_packet_may_intersect(const struct BoundingCuboid *cuboid, const struct RayPacket *packet);
+bool ray_packet_ray_intersects(const struct BoundingCuboid *cuboid, const struct RayPacket *packet, size_t ray_index, float closest_distance, float *tmin);
+bool ray_packet_get_active(const struct BoundingCuboid *cuboid, const struct RayPacket *packet, size_t active[2], const float *closest_distances, float *tmin);
+void bvh_get_closest_intersections(const struct BVH *bvh, const struct RayPacket *packet, const size_t active[2], struct Object **closest_objects, v3 *closest_normals, float *closest_distances);
+void leaf_get_closest_intersection(struct Object *object, const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance);
+bool leaf_is_light_blocked(const struct Object *object, const struct Ray *ray, float distance, v3 light_intensity, const struct Object *emittant_object);
+float bounding_cuboid_area(const struct BoundingCuboid *cuboid);
+void bvh_get_metrics(const struct BVH *bvh, uint32_t depth, uint32_t *max_depth, size_t *num_leaves, float *area_sum_nodes, float *area_sum_leaves);
+void bvh_print_metrics(const struct BVH *bvh);
+void bvh_init_morton(size_t num_leaves);
+void bvh_sort_morton(struct BVHWithMorton *leaf_array, size_t num_leaves, const struct BoundingCuboid *cuboid);
+void accel_build(void);
+void bvh_refit(struct BVH *bvh);
+size_t bvh_count_leaves(const struct BVH *bvh);
+void bvh_free_subtree(struct BVH *bvh, struct BVHWithMorton *leaf_array, size_t *num_leaves);
+void bvh_rebuild_degraded(struct BVH **bvh, float root_growth, size_t *num_subtrees, size_t *num_leaves);
+
+/* SBVH */
+void sbvh_init(size_t num_leaves, float max_references_factor);
+void bounding_cuboid_clear(struct BoundingCuboid *cuboid);
+void bounding_cuboid_grow(struct BoundingCuboid *cuboid, const struct BoundingCuboid *other);
+struct BVH *sbvh_generate_node(struct BVHReference *references, size_t num_references, const struct BoundingCuboid *cuboid);
+void sbvh_find_object_split(const struct BVHReference *references, size_t num_references, const struct BoundingCuboid *centroid_cuboid, struct SBVHSplit *split);
+size_t sbvh_object_bin(const struct BVHReference *reference, uint32_t axis, const struct BoundingCuboid *centroid_cuboid);
+void sbvh_find_spatial_split(const struct BVHReference *references, size_t num_references, const struct BoundingCuboid *cuboid, struct SBVHSplit *split);
+bool sbvh_clip_reference(const struct BVHReference *reference, uint32_t axis, float min, float max, struct BVHReference *clipped);
+size_t sbvh_partition_object(struct BVHReference *references, size_t num_references, const struct BoundingCuboid *centroid_cuboid, const struct SBVHSplit *split, struct BVHReference *left, struct BVHReference *right, size_t *num_right);
+size_t sbvh_partition_spatial(struct BVHReference *references, size_t num_references, const struct SBVHSplit *split, struct BVHReference *left, struct BVHReference *right, size_t *num_right);
 
+/* Quantized BVH */
+#ifdef QUANTIZED_BVH
+uint32_t qbvh_generate_node(const struct BVHWithMorton *leaf_array, size_t first, size_t last, struct BoundingCuboid *cuboid);
+void qbvh_init(size_t num_leaves);
+uint32_t qbvh_convert_node(const struct BVH *bvh);
+void qbvh_quantize(struct QBVHNode *node, const struct BoundingCuboid *cuboid, const struct BoundingCuboid child_cuboids[2]);
+void qbvh_refit(uint32_t node_ref, struct BoundingCuboid *cuboid);
+float qbvh_get_area(uint32_t node_ref);
+float qbvh_get_sah_cost(void);
+void qbvh_intersects(const struct QBVHNode *node, const struct Ray *ray, bool intersects[2], float tmin[2]);
+void qbvh_get_closest_intersection(uint32_t node_ref, const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance);
+bool qbvh_is_light_blocked(uint32_t node_ref, const struct Ray *ray, float distance, v3 light_intensity, const struct Object *emittant_object);
+#endif
+
+static struct Arena accel_arena; //Storage of bounding cuboids created by bounding_cuboid_new
+static struct Arena bvh_arena; //Storage of BVH nodes and their bounding cuboids
+#ifdef QUANTIZED_BVH
+static struct QBVHNode *qbvh_nodes;
+static size_t num_qbvh_nodes;
+static struct Object **qbvh_leaves; //Objects in order of traversal
+static size_t num_qbvh_leaves;
+static uint32_t qbvh_root;
+static float qbvh_build_sah_cost;
+#endif
 static struct BVH *accel;
+static struct BVH **bvh_free_nodes; //Internal nodes of subtree which is being rebuilt, reused by bvh_generate_node
+static size_t bvh_num_free_nodes;
+static float accel_rebuild_threshold = 2.f;
+static float sbvh_max_references_factor; //0 if BVH is built from Morton codes
+static size_t sbvh_num_references; //Number of leaves in SBVH
+static size_t sbvh_max_references;
+static float sbvh_min_overlap_area;
+static _Thread_local const struct Object *transparent_hits[ACCEL_MAX_TRANSPARENT_HITS]; //Transparent objects which attenuated current light ray, as SBVH may contain them in multiple leaves
+static _Thread_local size_t num_transparent_hits;
+_Thread_local uint32_t accel_traversal_cost;
 
 //Expands a number to only use 1 in every 3 bits
 // Adapted from https://developer.nvidia.com/blog/thinking-parallel-part-iii-tree-construction-gpu/
@@ -89,28 +209,35 @@ uint32_t morton_code(const v3 vec)
 
 struct BoundingCuboid *bounding_cuboid_new(const float epsilon, v3 corners[2])
 {
-	struct BoundingCuboid *bounding_cuboid = safe_malloc(sizeof(struct BoundingCuboid));
+	struct BoundingCuboid *bounding_cuboid = arena_alloc(&accel_arena, sizeof(struct BoundingCuboid));
 	bounding_cuboid->epsilon = epsilon;
 	memcpy(bounding_cuboid->corners, corners, sizeof(v3[2]));
 	return bounding_cuboid;
 }
 
-struct BoundingCuboid *bounding_cuboid_new_from_object(const struct Object *object)
+struct BoundingCuboid *bvh_bounding_cuboid_new(const float epsilon, v3 corners[2])
 {
-	struct BoundingCuboid *bounding_cuboid = safe_malloc(sizeof(struct BoundingCuboid));
-	object->object_data->get_corners(object, bounding_cuboid->corners);
-	bounding_cuboid->epsilon = object->epsilon;
+	struct BoundingCuboid *bounding_cuboid = arena_alloc(&bvh_arena, sizeof(struct BoundingCuboid));
+	bounding_cuboid->epsilon = epsilon;
+	memcpy(bounding_cuboid->corners, corners, sizeof(v3[2]));
 	return bounding_cuboid;
 }
 
-void bounding_cuboid_delete(struct BoundingCuboid *bounding_cuboid)
+struct BoundingCuboid *bounding_cuboid_new_from_object(const struct Object *object)
 {
-	free(bounding_cuboid);
+	struct BoundingCuboid *bounding_cuboid = arena_alloc(&bvh_arena, sizeof(struct BoundingCuboid));
+	object_get_corners(object, bounding_cuboid->corners);
+	bounding_cuboid->epsilon = object->epsilon;
+	return bounding_cuboid;
 }
 
 // Adapted from http://people.csail.mit.edu/amy/papers/box-jgt.pdf
 bool bounding_cuboid_intersects(const struct BoundingCuboid *cuboid, const struct Ray *ray, float *tmax, float *tmin)
 {
+	STAT_INC(STAT_BOX_TESTS);
+	STAT_CACHE_ACCESS(cuboid);
+	accel_traversal_cost++;
+
 	float tymin, tymax;
 
 	float divx = 1 / ray->direction[X];
@@ -159,25 +286,22 @@ bool bounding_cuboid_intersects(const struct BoundingCuboid *cuboid, const struc
 
 struct BVH *bvh_new(const bool is_leaf, const struct BoundingCuboid *bounding_cuboid)
 {
-	struct BVH *bvh = safe_malloc(sizeof(struct BVH) + (is_leaf ? 1 : 2) * sizeof(union BVHChild));
+	struct BVH *bvh = arena_alloc(&bvh_arena, sizeof(struct BVH) + (is_leaf ? 1 : 2) * sizeof(union BVHChild));
 	bvh->is_leaf = is_leaf;
 	bvh->bounding_cuboid = bounding_cuboid;
+	if (!is_leaf)
+		bvh->area = bounding_cuboid_area(bounding_cuboid);
 	return bvh;
 }
 
 void accel_deinit(void)
 {
-	bvh_delete(accel);
-}
-
-void bvh_delete(struct BVH *bvh)
-{
-	bounding_cuboid_delete(bvh->bounding_cuboid);
-	if (!bvh->is_leaf) {
-		bvh_delete(bvh->children[0].bvh);
-		bvh_delete(bvh->children[1].bvh);
-	}
-	free(bvh);
+	arena_deinit(&accel_arena);
+	arena_deinit(&bvh_arena);
+#ifdef QUANTIZED_BVH
+	free(qbvh_nodes);
+	free(qbvh_leaves);
+#endif
 }
 
 int bvh_morton_code_compare(const void *p1, const void *p2)
@@ -201,34 +325,29 @@ struct BoundingCuboid *bvh_generate_bounding_cuboid_leaf(const struct BVHWithMor
 				corners[1][j] = bounding_cuboid->corners[1][j];
 		}
 	}
-	return bounding_cuboid_new(epsilon, corners);
+	return bvh_bounding_cuboid_new(epsilon, corners);
 }
 
 struct BoundingCuboid *bvh_generate_bounding_cuboid_node(const struct BVH *bvh_left, const struct BVH *bvh_right)
 {
-	struct BoundingCuboid *left = bvh_left->bounding_cuboid, *right = bvh_right->bounding_cuboid;
-	float epsilon = fmaxf(left->epsilon, right->epsilon);
-	v3 corners[2] = {
-		{
-			fminf(left->corners[0][X], right->corners[0][X]),
-			fminf(left->corners[0][Y], right->corners[0][Y]),
-			fminf(left->corners[0][Z], right->corners[0][Z]),
-		},
-		{
-			fmaxf(left->corners[1][X], right->corners[1][X]),
-			fmaxf(left->corners[1][Y], right->corners[1][Y]),
-			fmaxf(left->corners[1][Z], right->corners[1][Z]),
-		},
-	};
-	return bounding_cuboid_new(epsilon, corners);
+	struct BoundingCuboid *bounding_cuboid = arena_alloc(&bvh_arena, sizeof(struct BoundingCuboid));
+	bounding_cuboid_merge(bvh_left->bounding_cuboid, bvh_right->bounding_cuboid, bounding_cuboid);
+	return bounding_cuboid;
 }
 
-// Adapted from https://developer.nvidia.com/blog/thinking-parallel-part-iii-tree-construction-gpu/
-struct BVH *bvh_generate_node(const struct BVHWithMorton *leaf_array, const size_t first, const size_t last)
+void bounding_cuboid_merge(const struct BoundingCuboid *left, const struct BoundingCuboid *right, struct BoundingCuboid *cuboid)
 {
-	if (first == last)
-		return leaf_array[first].bvh;
+	cuboid->epsilon = fmaxf(left->epsilon, right->epsilon);
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		cuboid->corners[0][i] = fminf(left->corners[0][i], right->corners[0][i]);
+		cuboid->corners[1][i] = fmaxf(left->corners[1][i], right->corners[1][i]);
+	}
+}
 
+// Adapted from https://developer.nvidia.com/blog/thinking-parallel-part-iii-tree-construction-gpu/
+size_t bvh_find_split(const struct BVHWithMorton *leaf_array, const size_t first, const size_t last)
+{
 	uint32_t first_code = leaf_array[first].morton_code;
 	uint32_t last_code = leaf_array[last].morton_code;
 
@@ -254,16 +373,49 @@ struct BVH *bvh_generate_node(const struct BVHWithMorton *leaf_array, const size
 			}
 		} while (step > 1);
 	}
+	return split;
+}
 
+struct BVH *bvh_generate_node(const struct BVHWithMorton *leaf_array, const size_t first, const size_t last)
+{
+	if (first == last)
+		return leaf_array[first].bvh;
+
+	size_t split = bvh_find_split(leaf_array, first, last);
 	struct BVH *bvh_left = bvh_generate_node(leaf_array, first, split);
 	struct BVH *bvh_right = bvh_generate_node(leaf_array, split + 1, last);
-	struct BVH *bvh = bvh_new(false, bvh_generate_bounding_cuboid_node(bvh_left, bvh_right));
+	struct BVH *bvh;
+	if (bvh_num_free_nodes) {
+		bvh = bvh_free_nodes[--bvh_num_free_nodes];
+		bounding_cuboid_merge(bvh_left->bounding_cuboid, bvh_right->bounding_cuboid, bvh->bounding_cuboid);
+		bvh->area = bounding_cuboid_area(bvh->bounding_cuboid);
+	} else {
+		bvh = bvh_new(false, bvh_generate_bounding_cuboid_node(bvh_left, bvh_right));
+	}
 	bvh->children[0].bvh = bvh_left;
 	bvh->children[1].bvh = bvh_right;
+	bvh->is_animated = bvh_left->is_animated || bvh_right->is_animated;
 	return bvh;
 }
 
 void accel_init(void)
+{
+	int idx = argv_check_with_args("--sbvh", 1);
+	if (idx) {
+		sbvh_max_references_factor = atof(myargv[idx + 1]);
+		error_check(sbvh_max_references_factor >= 1.f, "Expected SBVH reference budget [%f] of at least [1.0].", (double)sbvh_max_references_factor);
+	}
+
+	idx = argv_check_with_args("--rebuild-threshold", 1);
+	if (idx) {
+		accel_rebuild_threshold = atof(myargv[idx + 1]);
+		error_check(accel_rebuild_threshold >= 1.f, "Expected BVH rebuild threshold [%f] of at least [1.0].", (double)accel_rebuild_threshold);
+	}
+
+	accel_build();
+}
+
+void accel_build(void)
 {
 	printf_log("Generating BVH.");
 #ifdef UNBOUND_OBJECTS
@@ -271,6 +423,106 @@ void accel_init(void)
 #else
 	size_t num_leaves = num_objects;
 #endif
+
+	if (sbvh_max_references_factor)
+		sbvh_init(num_leaves, sbvh_max_references_factor);
+	else
+		bvh_init_morton(num_leaves);
+
+#ifdef QUANTIZED_BVH
+	qbvh_build_sah_cost = qbvh_get_sah_cost();
+	printf_log("Quantized BVH has SAH cost [%f].", (double)qbvh_build_sah_cost);
+#endif
+}
+
+//Refits BVH to objects which moved, then rebuilds parts of it whose quality degraded
+void accel_update(void)
+{
+#ifdef QUANTIZED_BVH
+	struct BoundingCuboid cuboid;
+	qbvh_refit(qbvh_root, &cuboid);
+	float sah_cost = qbvh_get_sah_cost();
+	if (sah_cost > accel_rebuild_threshold * qbvh_build_sah_cost) {
+		printf_log("Refit quantized BVH has SAH cost [%f], exceeding [%f] when built.", (double)sah_cost, (double)qbvh_build_sah_cost);
+		free(qbvh_nodes);
+		free(qbvh_leaves);
+		accel_build();
+	} else {
+		printf_log("Refit quantized BVH has SAH cost [%f].", (double)sah_cost);
+	}
+#else
+	bvh_refit(accel);
+
+	size_t num_subtrees = 0, num_leaves = 0;
+	float growth = bounding_cuboid_area(accel->bounding_cuboid) / fmaxf(accel->area, FLT_MIN);
+	bvh_rebuild_degraded(&accel, growth, &num_subtrees, &num_leaves);
+	printf_log("Refit BVH and rebuilt [%zu] subtrees with [%zu] leaves.", num_subtrees, num_leaves);
+#endif
+}
+
+void bvh_refit(struct BVH *bvh)
+{
+	if (!bvh->is_animated)
+		return;
+	if (bvh->is_leaf) {
+		const struct Object *object = bvh->children[0].object;
+		object_get_corners(object, bvh->bounding_cuboid->corners);
+		return;
+	}
+
+	bvh_refit(bvh->children[0].bvh);
+	bvh_refit(bvh->children[1].bvh);
+	bounding_cuboid_merge(bvh->children[0].bvh->bounding_cuboid, bvh->children[1].bvh->bounding_cuboid, bvh->bounding_cuboid);
+}
+
+size_t bvh_count_leaves(const struct BVH *bvh)
+{
+	if (bvh->is_leaf)
+		return 1;
+	return bvh_count_leaves(bvh->children[0].bvh) + bvh_count_leaves(bvh->children[1].bvh);
+}
+
+//Appends leaves of subtree to leaf_array, and its internal nodes to bvh_free_nodes
+void bvh_free_subtree(struct BVH *bvh, struct BVHWithMorton *leaf_array, size_t *num_leaves)
+{
+	if (bvh->is_leaf) {
+		leaf_array[(*num_leaves)++].bvh = bvh;
+		return;
+	}
+	bvh_free_nodes[bvh_num_free_nodes++] = bvh;
+	bvh_free_subtree(bvh->children[0].bvh, leaf_array, num_leaves);
+	bvh_free_subtree(bvh->children[1].bvh, leaf_array, num_leaves);
+}
+
+//Rebuilds subtrees whose surface area grew more than accel_rebuild_threshold times as much as the root's since they were built
+void bvh_rebuild_degraded(struct BVH **bvh, const float root_growth, size_t *num_subtrees, size_t *num_leaves)
+{
+	if ((*bvh)->is_leaf || !(*bvh)->is_animated)
+		return;
+
+	float growth = bounding_cuboid_area((*bvh)->bounding_cuboid) / fmaxf((*bvh)->area, FLT_MIN);
+	if (growth <= accel_rebuild_threshold * root_growth) {
+		bvh_rebuild_degraded(&(*bvh)->children[0].bvh, root_growth, num_subtrees, num_leaves);
+		bvh_rebuild_degraded(&(*bvh)->children[1].bvh, root_growth, num_subtrees, num_leaves);
+		return;
+	}
+
+	size_t num_subtree_leaves = bvh_count_leaves(*bvh);
+	struct BVHWithMorton *leaf_array = safe_malloc(sizeof(struct BVHWithMorton) * num_subtree_leaves);
+	bvh_free_nodes = safe_malloc(sizeof(struct BVH *) * (num_subtree_leaves - 1));
+	size_t i = 0;
+	bvh_free_subtree(*bvh, leaf_array, &i);
+	bvh_sort_morton(leaf_array, num_subtree_leaves, (*bvh)->bounding_cuboid);
+	*bvh = bvh_generate_node(leaf_array, 0, num_subtree_leaves - 1);
+	free(leaf_array);
+	free(bvh_free_nodes);
+
+	*num_subtrees += 1;
+	*num_leaves += num_subtree_leaves;
+}
+
+void bvh_init_morton(const size_t num_leaves)
+{
 	struct BVHWithMorton *leaf_array = safe_malloc(sizeof(struct BVHWithMorton) * num_leaves);
 
 	size_t i, j = 0;
@@ -281,23 +533,48 @@ void accel_init(void)
 #endif
 			struct BVH *bvh = bvh_new(true, bounding_cuboid_new_from_object(object));
 			bvh->children[0].object = object;
+			bvh->is_animated = object->is_animated;
 			leaf_array[j++].bvh = bvh;
 #ifdef UNBOUND_OBJECTS
 		}
 #endif
 	}
 
-	v3 min, max;
-	get_objects_extents(min, max);
+	struct BoundingCuboid cuboid;
+	get_objects_extents(cuboid.corners[0], cuboid.corners[1]);
+	bvh_sort_morton(leaf_array, num_leaves, &cuboid);
+
+#ifdef QUANTIZED_BVH
+	/* Internal nodes are quantized while they are generated, so only leaves are stored in bvh_arena */
+	qbvh_init(num_leaves);
+	qbvh_root = qbvh_generate_node(leaf_array, 0, num_leaves - 1, &cuboid);
+	arena_deinit(&bvh_arena);
+
+	free(leaf_array);
+
+	printf_log("Quantized BVH to [%u] bits using [%zu] bytes.", (unsigned)(8 * sizeof(qbvh_bound_t)), sizeof(struct QBVHNode) * num_qbvh_nodes + sizeof(struct Object *) * num_qbvh_leaves);
+#else
+	accel = bvh_generate_node(leaf_array, 0, num_leaves - 1);
+
+	free(leaf_array);
+
+	bvh_print_metrics(accel);
+#endif
+}
 
-	v3 mul;
-	sub3v(max, min, mul);
+//Sorts leaves by Morton code of their centers within cuboid
+void bvh_sort_morton(struct BVHWithMorton *leaf_array, const size_t num_leaves, const struct BoundingCuboid *cuboid)
+{
+	v3 min, mul;
+	sub3v(cuboid->corners[1], cuboid->corners[0], mul);
 	inv3(mul);
 
 	/* Embed halving of bounding cuboid corners to get mean */
 	mul3s(mul, 0.5f, mul);
-	mul3s(min, 2.f, min);
+	mul3s(cuboid->corners[0], 2.f, min);
+	mul3v(min, mul, min);
 
+	size_t i;
 	for (i = 0; i < num_leaves; i++) {
 		struct BoundingCuboid *bounding_cuboid = leaf_array[i].bvh->bounding_cuboid;
 		v3 norm_position;
@@ -308,33 +585,427 @@ void accel_init(void)
 	}
 
 	qsort(leaf_array, num_leaves, sizeof(struct BVHWithMorton), &bvh_morton_code_compare);
+}
 
-	accel = bvh_generate_node(leaf_array, 0, num_leaves - 1);
+// Adapted from https://www.nvidia.com/docs/IO/77714/sbvh.pdf
+void sbvh_init(const size_t num_leaves, const float max_references_factor)
+{
+	struct BVHReference *references = safe_malloc(sizeof(struct BVHReference) * num_leaves);
+	struct BoundingCuboid cuboid;
+	bounding_cuboid_clear(&cuboid);
 
-	free(leaf_array);
+	size_t i, j = 0;
+	for (i = 0; i < num_objects; i++) {
+		struct Object *object = objects[i];
+#ifdef UNBOUND_OBJECTS
+		if (object->object_data->is_bounded) {
+#endif
+			struct BVHReference *reference = &references[j++];
+			reference->object = object;
+			object_get_corners(object, reference->cuboid.corners);
+			reference->cuboid.epsilon = object->epsilon;
+			bounding_cuboid_grow(&cuboid, &reference->cuboid);
+#ifdef UNBOUND_OBJECTS
+		}
+#endif
+	}
+
+	sbvh_num_references = num_leaves;
+	sbvh_max_references = (size_t)(max_references_factor * num_leaves);
+	sbvh_min_overlap_area = SBVH_MIN_OVERLAP * bounding_cuboid_area(&cuboid);
+	accel = sbvh_generate_node(references, num_leaves, &cuboid);
+	printf_log("SBVH has [%zu] references to [%zu] objects.", sbvh_num_references, num_leaves);
+	bvh_print_metrics(accel);
+
+#ifdef QUANTIZED_BVH
+	qbvh_init(sbvh_num_references);
+	qbvh_root = qbvh_convert_node(accel);
+	arena_deinit(&bvh_arena);
+	accel = NULL;
+	printf_log("Quantized BVH to [%u] bits using [%zu] bytes.", (unsigned)(8 * sizeof(qbvh_bound_t)), sizeof(struct QBVHNode) * num_qbvh_nodes + sizeof(struct Object *) * num_qbvh_leaves);
+#endif
+}
+
+void bounding_cuboid_clear(struct BoundingCuboid *cuboid)
+{
+	cuboid->epsilon = 0.f;
+	// clang-format off
+	cuboid->corners[0][X] = FLT_MAX; cuboid->corners[0][Y] = FLT_MAX; cuboid->corners[0][Z] = FLT_MAX;
+	cuboid->corners[1][X] = -FLT_MAX; cuboid->corners[1][Y] = -FLT_MAX; cuboid->corners[1][Z] = -FLT_MAX;
+	// clang-format on
+}
+
+void bounding_cuboid_grow(struct BoundingCuboid *cuboid, const struct BoundingCuboid *other)
+{
+	bounding_cuboid_merge(cuboid, other, cuboid);
+}
+
+//Frees references
+struct BVH *sbvh_generate_node(struct BVHReference *references, const size_t num_references, const struct BoundingCuboid *cuboid)
+{
+	if (num_references == 1) {
+		struct BVH *bvh = bvh_new(true, bvh_bounding_cuboid_new(references[0].cuboid.epsilon, references[0].cuboid.corners));
+		bvh->children[0].object = references[0].object;
+		bvh->is_animated = references[0].object->is_animated;
+		free(references);
+		return bvh;
+	}
+
+	struct BoundingCuboid centroid_cuboid;
+	bounding_cuboid_clear(&centroid_cuboid);
+	size_t i;
+	for (i = 0; i < num_references; i++) {
+		struct BoundingCuboid centroid = { 0 };
+		add3v(references[i].cuboid.corners[0], references[i].cuboid.corners[1], centroid.corners[0]);
+		mul3s(centroid.corners[0], 0.5f, centroid.corners[0]);
+		assign3(centroid.corners[1], centroid.corners[0]);
+		bounding_cuboid_grow(&centroid_cuboid, &centroid);
+	}
+
+	struct SBVHSplit split;
+	sbvh_find_object_split(references, num_references, &centroid_cuboid, &split);
+
+	if (sbvh_num_references < sbvh_max_references && split.cost < INFINITY) {
+		struct BoundingCuboid overlap;
+		for (i = 0; i < 3; i++) {
+			overlap.corners[0][i] = fmaxf(split.cuboids[0].corners[0][i], split.cuboids[1].corners[0][i]);
+			overlap.corners[1][i] = fminf(split.cuboids[0].corners[1][i], split.cuboids[1].corners[1][i]);
+		}
+		if (overlap.corners[0][X] < overlap.corners[1][X] && overlap.corners[0][Y] < overlap.corners[1][Y] && overlap.corners[0][Z] < overlap.corners[1][Z]
+			&& bounding_cuboid_area(&overlap) > sbvh_min_overlap_area) {
+			struct SBVHSplit spatial_split;
+			sbvh_find_spatial_split(references, num_references, cuboid, &spatial_split);
+			if (spatial_split.cost < split.cost)
+				split = spatial_split;
+		}
+	}
+
+	/* Spatially split references may be in both children */
+	struct BVHReference *children_references[2] = {
+		safe_malloc(sizeof(struct BVHReference) * num_references),
+		safe_malloc(sizeof(struct BVHReference) * num_references),
+	};
+	size_t num_children_references[2];
+	if (split.cost == INFINITY) { //Centroids coincide, so split in half
+		num_children_references[0] = num_references / 2;
+		num_children_references[1] = num_references - num_children_references[0];
+		memcpy(children_references[0], references, sizeof(struct BVHReference) * num_children_references[0]);
+		memcpy(children_references[1], references + num_children_references[0], sizeof(struct BVHReference) * num_children_references[1]);
+	} else if (split.is_spatial) {
+		num_children_references[0] = sbvh_partition_spatial(references, num_references, &split, children_references[0], children_references[1], &num_children_references[1]);
+	} else {
+		num_children_references[0] = sbvh_partition_object(references, num_references, &centroid_cuboid, &split, children_references[0], children_references[1], &num_children_references[1]);
+	}
+	free(references);
+
+	struct BoundingCuboid children_cuboids[2];
+	for (i = 0; i < 2; i++) {
+		bounding_cuboid_clear(&children_cuboids[i]);
+		size_t j;
+		for (j = 0; j < num_children_references[i]; j++)
+			bounding_cuboid_grow(&children_cuboids[i], &children_references[i][j].cuboid);
+	}
+
+	struct BVH *bvh = bvh_new(false, bvh_bounding_cuboid_new(cuboid->epsilon, (v3 *)cuboid->corners));
+	bvh->children[0].bvh = sbvh_generate_node(children_references[0], num_children_references[0], &children_cuboids[0]);
+	bvh->children[1].bvh = sbvh_generate_node(children_references[1], num_children_references[1], &children_cuboids[1]);
+	bvh->is_animated = bvh->children[0].bvh->is_animated || bvh->children[1].bvh->is_animated;
+	return bvh;
+}
+
+//Binned surface area heuristic
+void sbvh_find_object_split(const struct BVHReference *references, const size_t num_references, const struct BoundingCuboid *centroid_cuboid, struct SBVHSplit *split)
+{
+	split->cost = INFINITY;
+	split->is_spatial = false;
+
+	uint32_t axis;
+	for (axis = 0; axis < 3; axis++) {
+		if (centroid_cuboid->corners[1][axis] <= centroid_cuboid->corners[0][axis])
+			continue;
+
+		struct SBVHBin bins[SBVH_NUM_BINS];
+		size_t i;
+		for (i = 0; i < SBVH_NUM_BINS; i++) {
+			bounding_cuboid_clear(&bins[i].cuboid);
+			bins[i].num_entries = 0;
+		}
+		for (i = 0; i < num_references; i++) {
+			struct SBVHBin *bin = &bins[sbvh_object_bin(&references[i], axis, centroid_cuboid)];
+			bounding_cuboid_grow(&bin->cuboid, &references[i].cuboid);
+			bin->num_entries++;
+		}
+
+		struct BoundingCuboid right_cuboids[SBVH_NUM_BINS];
+		size_t right_counts[SBVH_NUM_BINS];
+		bounding_cuboid_clear(&right_cuboids[SBVH_NUM_BINS - 1]);
+		bounding_cuboid_grow(&right_cuboids[SBVH_NUM_BINS - 1], &bins[SBVH_NUM_BINS - 1].cuboid);
+		right_counts[SBVH_NUM_BINS - 1] = bins[SBVH_NUM_BINS - 1].num_entries;
+		for (i = SBVH_NUM_BINS - 1; i > 0; i--) {
+			right_cuboids[i - 1] = right_cuboids[i];
+			bounding_cuboid_grow(&right_cuboids[i - 1], &bins[i - 1].cuboid);
+			right_counts[i - 1] = right_counts[i] + bins[i - 1].num_entries;
+		}
+
+		struct BoundingCuboid left_cuboid;
+		bounding_cuboid_clear(&left_cuboid);
+		size_t left_count = 0;
+		for (i = 0; i < SBVH_NUM_BINS - 1; i++) {
+			bounding_cuboid_grow(&left_cuboid, &bins[i].cuboid);
+			left_count += bins[i].num_entries;
+			if (!left_count || !right_counts[i + 1])
+				continue;
+			float cost = bounding_cuboid_area(&left_cuboid) * left_count + bounding_cuboid_area(&right_cuboids[i + 1]) * right_counts[i + 1];
+			if (cost < split->cost) {
+				split->cost = cost;
+				split->axis = axis;
+				split->bin = i;
+				split->cuboids[0] = left_cuboid;
+				split->cuboids[1] = right_cuboids[i + 1];
+				split->num_references[0] = left_count;
+				split->num_references[1] = right_counts[i + 1];
+			}
+		}
+	}
+}
+
+size_t sbvh_object_bin(const struct BVHReference *reference, const uint32_t axis, const struct BoundingCuboid *centroid_cuboid)
+{
+	float centroid = 0.5f * (reference->cuboid.corners[0][axis] + reference->cuboid.corners[1][axis]);
+	float extent = centroid_cuboid->corners[1][axis] - centroid_cuboid->corners[0][axis];
+	size_t bin = (size_t)((centroid - centroid_cuboid->corners[0][axis]) / extent * SBVH_NUM_BINS);
+	return bin < SBVH_NUM_BINS ? bin : SBVH_NUM_BINS - 1;
+}
+
+//Binned surface area heuristic, where each reference is clipped to the bins it spans
+void sbvh_find_spatial_split(const struct BVHReference *references, const size_t num_references, const struct BoundingCuboid *cuboid, struct SBVHSplit *split)
+{
+	split->cost = INFINITY;
+	split->is_spatial = true;
+
+	uint32_t axis;
+	for (axis = 0; axis < 3; axis++) {
+		float min = cuboid->corners[0][axis];
+		float bin_width = (cuboid->corners[1][axis] - min) / SBVH_NUM_BINS;
+		if (bin_width <= 0.f)
+			continue;
+
+		struct SBVHBin bins[SBVH_NUM_BINS];
+		size_t i, j;
+		for (i = 0; i < SBVH_NUM_BINS; i++) {
+			bounding_cuboid_clear(&bins[i].cuboid);
+			bins[i].num_entries = 0;
+			bins[i].num_exits = 0;
+		}
+		for (i = 0; i < num_references; i++) {
+			const struct BVHReference *reference = &references[i];
+			size_t first = (size_t)((reference->cuboid.corners[0][axis] - min) / bin_width);
+			size_t last = (size_t)((reference->cuboid.corners[1][axis] - min) / bin_width);
+			first = first < SBVH_NUM_BINS ? first : SBVH_NUM_BINS - 1;
+			last = last < SBVH_NUM_BINS ? last : SBVH_NUM_BINS - 1;
+			bins[first].num_entries++;
+			bins[last].num_exits++;
+			if (first == last) {
+				bounding_cuboid_grow(&bins[first].cuboid, &reference->cuboid);
+				continue;
+			}
+			for (j = first; j <= last; j++) {
+				struct BVHReference clipped;
+				if (sbvh_clip_reference(reference, axis, min + j * bin_width, j == SBVH_NUM_BINS - 1 ? cuboid->corners[1][axis] : min + (j + 1) * bin_width, &clipped))
+					bounding_cuboid_grow(&bins[j].cuboid, &clipped.cuboid);
+			}
+		}
+
+		struct BoundingCuboid right_cuboids[SBVH_NUM_BINS];
+		size_t right_counts[SBVH_NUM_BINS];
+		bounding_cuboid_clear(&right_cuboids[SBVH_NUM_BINS - 1]);
+		bounding_cuboid_grow(&right_cuboids[SBVH_NUM_BINS - 1], &bins[SBVH_NUM_BINS - 1].cuboid);
+		right_counts[SBVH_NUM_BINS - 1] = bins[SBVH_NUM_BINS - 1].num_exits;
+		for (i = SBVH_NUM_BINS - 1; i > 0; i--) {
+			right_cuboids[i - 1] = right_cuboids[i];
+			bounding_cuboid_grow(&right_cuboids[i - 1], &bins[i - 1].cuboid);
+			right_counts[i - 1] = right_counts[i] + bins[i - 1].num_exits;
+		}
+
+		struct BoundingCuboid left_cuboid;
+		bounding_cuboid_clear(&left_cuboid);
+		size_t left_count = 0;
+		for (i = 0; i < SBVH_NUM_BINS - 1; i++) {
+			bounding_cuboid_grow(&left_cuboid, &bins[i].cuboid);
+			left_count += bins[i].num_entries;
+			if (!left_count || !right_counts[i + 1])
+				continue;
+			float cost = bounding_cuboid_area(&left_cuboid) * left_count + bounding_cuboid_area(&right_cuboids[i + 1]) * right_counts[i + 1];
+			if (cost < split->cost) {
+				split->cost = cost;
+				split->axis = axis;
+				split->position = min + (i + 1) * bin_width;
+				split->cuboids[0] = left_cuboid;
+				split->cuboids[1] = right_cuboids[i + 1];
+				split->num_references[0] = left_count;
+				split->num_references[1] = right_counts[i + 1];
+			}
+		}
+	}
+}
+
+//Returns false if no part of the reference lies between min and max along axis
+bool sbvh_clip_reference(const struct BVHReference *reference, const uint32_t axis, const float min, const float max, struct BVHReference *clipped)
+{
+	v3 bounds[2];
+	memcpy(bounds, reference->cuboid.corners, sizeof(v3[2]));
+	bounds[0][axis] = fmaxf(bounds[0][axis], min);
+	bounds[1][axis] = fminf(bounds[1][axis], max);
+
+	clipped->object = reference->object;
+	clipped->cuboid.epsilon = reference->cuboid.epsilon;
+	object_get_clipped_corners(reference->object, bounds, clipped->cuboid.corners);
+	return clipped->cuboid.corners[0][X] <= clipped->cuboid.corners[1][X]
+		&& clipped->cuboid.corners[0][Y] <= clipped->cuboid.corners[1][Y]
+		&& clipped->cuboid.corners[0][Z] <= clipped->cuboid.corners[1][Z];
+}
+
+//Returns number of references in left child
+size_t sbvh_partition_object(struct BVHReference *references, const size_t num_references, const struct BoundingCuboid *centroid_cuboid, const struct SBVHSplit *split, struct BVHReference *left, struct BVHReference *right, size_t *num_right)
+{
+	size_t i, num_left = 0;
+	*num_right = 0;
+	for (i = 0; i < num_references; i++) {
+		if (sbvh_object_bin(&references[i], split->axis, centroid_cuboid) <= split->bin)
+			left[num_left++] = references[i];
+		else
+			right[(*num_right)++] = references[i];
+	}
+	return num_left;
+}
+
+//Returns number of references in left child. References spanning the split are either split or moved to one child, depending on which is cheaper
+size_t sbvh_partition_spatial(struct BVHReference *references, const size_t num_references, const struct SBVHSplit *split, struct BVHReference *left, struct BVHReference *right, size_t *num_right)
+{
+	const uint32_t axis = split->axis;
+	const float area_left = bounding_cuboid_area(&split->cuboids[0]);
+	const float area_right = bounding_cuboid_area(&split->cuboids[1]);
+	const float count_left = split->num_references[0], count_right = split->num_references[1];
+
+	size_t i, num_left = 0;
+	*num_right = 0;
+	for (i = 0; i < num_references; i++) {
+		struct BVHReference *reference = &references[i];
+		if (reference->cuboid.corners[1][axis] <= split->position) {
+			left[num_left++] = *reference;
+			continue;
+		}
+		if (reference->cuboid.corners[0][axis] >= split->position) {
+			right[(*num_right)++] = *reference;
+			continue;
+		}
+
+		struct BoundingCuboid left_cuboid = split->cuboids[0], right_cuboid = split->cuboids[1];
+		bounding_cuboid_grow(&left_cuboid, &reference->cuboid);
+		bounding_cuboid_grow(&right_cuboid, &reference->cuboid);
+		float cost_split = area_left * count_left + area_right * count_right;
+		float cost_left = bounding_cuboid_area(&left_cuboid) * count_left + area_right * (count_right - 1.f);
+		float cost_right = area_left * (count_left - 1.f) + bounding_cuboid_area(&right_cuboid) * count_right;
+
+		struct BVHReference clipped[2];
+		if (sbvh_num_references < sbvh_max_references && cost_split < cost_left && cost_split < cost_right
+			&& sbvh_clip_reference(reference, axis, -FLT_MAX, split->position, &clipped[0])
+			&& sbvh_clip_reference(reference, axis, split->position, FLT_MAX, &clipped[1])) {
+			left[num_left++] = clipped[0];
+			right[(*num_right)++] = clipped[1];
+			sbvh_num_references++;
+		} else if (cost_left < cost_right) {
+			left[num_left++] = *reference;
+		} else {
+			right[(*num_right)++] = *reference;
+		}
+	}
+
+	/* Unsplitting may leave a child empty */
+	if (!num_left || !*num_right) {
+		*num_right = num_references / 2;
+		if (!num_left) {
+			memcpy(left, right + *num_right, sizeof(struct BVHReference) * (num_references - *num_right));
+			return num_references - *num_right;
+		}
+		memcpy(right, left + num_left - *num_right, sizeof(struct BVHReference) * *num_right);
+		return num_left - *num_right;
+	}
+	return num_left;
+}
+
+float bounding_cuboid_area(const struct BoundingCuboid *cuboid)
+{
+	v3 size;
+	sub3v(cuboid->corners[1], cuboid->corners[0], size);
+	return 2.f * (size[X] * size[Y] + size[Y] * size[Z] + size[Z] * size[X]);
+}
+
+void bvh_get_metrics(const struct BVH *bvh, const uint32_t depth, uint32_t *max_depth, size_t *num_leaves, float *area_sum_nodes, float *area_sum_leaves)
+{
+	if (depth > *max_depth)
+		*max_depth = depth;
+	if (bvh->is_leaf) {
+		*num_leaves += 1;
+		*area_sum_leaves += bounding_cuboid_area(bvh->bounding_cuboid);
+		return;
+	}
+	*area_sum_nodes += bounding_cuboid_area(bvh->bounding_cuboid);
+	bvh_get_metrics(bvh->children[0].bvh, depth + 1, max_depth, num_leaves, area_sum_nodes, area_sum_leaves);
+	bvh_get_metrics(bvh->children[1].bvh, depth + 1, max_depth, num_leaves, area_sum_nodes, area_sum_leaves);
+}
+
+//Surface area heuristic cost with unit traversal and intersection costs
+void bvh_print_metrics(const struct BVH *bvh)
+{
+	uint32_t max_depth = 0;
+	size_t num_leaves = 0;
+	float area_sum_nodes = 0.f, area_sum_leaves = 0.f;
+	bvh_get_metrics(bvh, 0, &max_depth, &num_leaves, &area_sum_nodes, &area_sum_leaves);
+	float sah_cost = (area_sum_nodes + area_sum_leaves) / bounding_cuboid_area(bvh->bounding_cuboid);
+	printf_log("BVH has depth [%u], [%zu] leaves, and SAH cost [%f].", max_depth, num_leaves, (double)sah_cost);
 }
 
 void accel_get_closest_intersection(const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance)
 {
+#ifdef QUANTIZED_BVH
+	qbvh_get_closest_intersection(qbvh_root, ray, closest_object, closest_normal, closest_distance);
+#else
 	bvh_get_closest_intersection(accel, ray, closest_object, closest_normal, closest_distance);
+#endif
 }
 
-void bvh_get_closest_intersection(const struct BVH *bvh, const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance)
+void leaf_get_closest_intersection(struct Object *object, const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance)
 {
-	if (bvh->is_leaf) {
-		v3 normal;
-		struct Object *object = bvh->children[0].object;
-		float distance;
-		if (object->object_data->get_intersection(object, ray, &distance, normal) && distance < *closest_distance) {
+	v3 normal;
+	float distance;
+	STAT_INC(STAT_PRIMITIVE_TESTS);
+	STAT_CACHE_ACCESS(object);
+	accel_traversal_cost++;
+	if (object_get_intersection(object, ray, &distance, normal)) {
+		STAT_INC_HIT(object->object_data->type);
+		if (distance < *closest_distance) {
 			*closest_distance = distance;
 			*closest_object = object;
 			assign3(closest_normal, normal);
 		}
+	}
+}
+
+void bvh_get_closest_intersection(const struct BVH *bvh, const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance)
+{
+	STAT_INC(STAT_BVH_NODES_VISITED);
+	STAT_CACHE_ACCESS(bvh);
+
+	if (bvh->is_leaf) {
+		leaf_get_closest_intersection(bvh->children[0].object, ray, closest_object, closest_normal, closest_distance);
 		return;
 	}
 
 	bool intersect_l, intersect_r;
 	float tmin_l, tmin_r, tmax;
+	STAT_CACHE_ACCESS(bvh->children[0].bvh); //Children hold pointers to their bounding cuboids
+	STAT_CACHE_ACCESS(bvh->children[1].bvh);
 	intersect_l = bounding_cuboid_intersects(bvh->children[0].bvh->bounding_cuboid, ray, &tmax, &tmin_l) && tmin_l < *closest_distance;
 	intersect_r = bounding_cuboid_intersects(bvh->children[1].bvh->bounding_cuboid, ray, &tmax, &tmin_r) && tmin_r < *closest_distance;
 	if (intersect_l && intersect_r) {
@@ -352,32 +1023,186 @@ void bvh_get_closest_intersection(const struct BVH *bvh, const struct Ray *ray,
 	}
 }
 
-bool accel_is_light_blocked(const struct Ray *ray, const float distance, v3 light_intensity, const struct Object *emittant_object)
+void accel_get_closest_intersections(const struct Ray *rays, const size_t num_rays, struct Object **closest_objects, v3 *closest_normals, float *closest_distances)
 {
-	return bvh_is_light_blocked(accel, ray, distance, light_intensity, emittant_object);
+	size_t i;
+#ifndef QUANTIZED_BVH
+	struct RayPacket packet;
+	if (ray_packet_init(&packet, rays, num_rays)) {
+		bvh_get_closest_intersections(accel, &packet, (size_t[2]){ 0, num_rays }, closest_objects, closest_normals, closest_distances);
+		return;
+	}
+#endif
+	for (i = 0; i < num_rays; i++)
+		accel_get_closest_intersection(&rays[i], &closest_objects[i], closest_normals[i], &closest_distances[i]);
 }
 
-bool bvh_is_light_blocked(const struct BVH *bvh, const struct Ray *ray, const float distance, v3 light_intensity, const struct Object *emittant_object)
+//Returns false if rays diverge, so that packet cannot be bounded
+bool ray_packet_init(struct RayPacket *packet, const struct Ray *rays, const size_t num_rays)
 {
-	float tmin, tmax;
+	packet->rays = rays;
+	packet->num_rays = num_rays;
+	size_t i, j;
+	for (j = 0; j < 3; j++) {
+		if (rays[0].direction[j] == 0.f)
+			return false;
+		packet->near_corner[j] = rays[0].direction[j] < 0.f;
+	}
+	assign3(packet->point_bounds[0], rays[0].point);
+	assign3(packet->point_bounds[1], rays[0].point);
+	assign3(packet->inverse_direction_bounds[0], ((v3){ FLT_MAX, FLT_MAX, FLT_MAX }));
+	assign3(packet->inverse_direction_bounds[1], ((v3){ -FLT_MAX, -FLT_MAX, -FLT_MAX }));
+	for (i = 0; i < num_rays; i++) {
+		for (j = 0; j < 3; j++) {
+			if (rays[i].direction[j] == 0.f || (size_t)(rays[i].direction[j] < 0.f) != packet->near_corner[j])
+				return false;
+			float div = 1 / rays[i].direction[j];
+			packet->inverse_directions[i][j] = div;
+			packet->inverse_direction_bounds[0][j] = fminf(packet->inverse_direction_bounds[0][j], div);
+			packet->inverse_direction_bounds[1][j] = fmaxf(packet->inverse_direction_bounds[1][j], div);
+			packet->point_bounds[0][j] = fminf(packet->point_bounds[0][j], rays[i].point[j]);
+			packet->point_bounds[1][j] = fmaxf(packet->point_bounds[1][j], rays[i].point[j]);
+		}
+	}
+	return true;
+}
 
-	if (bvh->is_leaf) {
-		v3 normal;
-		struct Object *object = bvh->children[0].object;
-		if (object == emittant_object)
+//Slab test in interval arithmetic. Returns false if no ray in packet can intersect cuboid
+bool ray_packet_may_intersect(const struct BoundingCuboid *cuboid, const struct RayPacket *packet)
+{
+	float tmin = -FLT_MAX, tmax = FLT_MAX;
+	size_t i, j;
+	for (j = 0; j < 3; j++) {
+		const float near = cuboid->corners[packet->near_corner[j]][j], far = cuboid->corners[!packet->near_corner[j]][j];
+		float near_min = FLT_MAX, far_max = -FLT_MAX;
+		for (i = 0; i < 4; i++) { //Extremes of products of intervals are at their bounds
+			const float point = packet->point_bounds[i & 1][j], div = packet->inverse_direction_bounds[i >> 1][j];
+			near_min = fminf(near_min, (near - point) * div);
+			far_max = fmaxf(far_max, (far - point) * div);
+		}
+		tmin = fmaxf(tmin, near_min);
+		tmax = fminf(tmax, far_max);
+	}
+	return tmin <= tmax && tmax > cuboid->epsilon;
+}
+
+//Equivalent to bounding_cuboid_intersects, but reuses inverse direction. Only intersections closer than closest_distance are counted
+bool ray_packet_ray_intersects(const struct BoundingCuboid *cuboid, const struct RayPacket *packet, const size_t ray_index, const float closest_distance, float *tmin)
+{
+	STAT_INC(STAT_BOX_TESTS);
+	accel_traversal_cost++;
+
+	const float *point = packet->rays[ray_index].point, *div = packet->inverse_directions[ray_index];
+	float tmax = FLT_MAX;
+	*tmin = -FLT_MAX;
+	size_t j;
+	for (j = 0; j < 3; j++) {
+		*tmin = fmaxf(*tmin, (cuboid->corners[packet->near_corner[j]][j] - point[j]) * div[j]);
+		tmax = fminf(tmax, (cuboid->corners[!packet->near_corner[j]][j] - point[j]) * div[j]);
+	}
+	return *tmin <= tmax && tmax > cuboid->epsilon && *tmin < closest_distance;
+}
+
+//Narrows range of active rays [active[0], active[1]) to the first and last which intersect cuboid closer than their closest intersection. Returns false if none does
+bool ray_packet_get_active(const struct BoundingCuboid *cuboid, const struct RayPacket *packet, size_t active[2], const float *closest_distances, float *tmin)
+{
+	size_t first = active[0], last = active[1];
+	STAT_CACHE_ACCESS(cuboid);
+	if (!ray_packet_ray_intersects(cuboid, packet, first, closest_distances[first], tmin)) {
+		if (!ray_packet_may_intersect(cuboid, packet)) {
+			STAT_INC(STAT_PACKET_CULLS);
 			return false;
-		if (object->object_data->get_intersection(object, ray, &tmin, normal) && tmin < distance) {
-			if (object->material->transparent)
-				mul3v(light_intensity, object->material->kt, light_intensity);
-			else
-				return true;
 		}
+		do {
+			if (++first == last)
+				return false;
+		} while (!ray_packet_ray_intersects(cuboid, packet, first, closest_distances[first], tmin));
+	}
+	float tmin_last;
+	while (last - 1 > first && !ray_packet_ray_intersects(cuboid, packet, last - 1, closest_distances[last - 1], &tmin_last))
+		last--;
+	active[0] = first;
+	active[1] = last;
+	return true;
+}
+
+//Traverses packet while any active ray intersects node. Children are visited in order of the first active ray's distance to them
+void bvh_get_closest_intersections(const struct BVH *bvh, const struct RayPacket *packet, const size_t active[2], struct Object **closest_objects, v3 *closest_normals, float *closest_distances)
+{
+	STAT_INC(STAT_BVH_NODES_VISITED);
+	STAT_CACHE_ACCESS(bvh);
+
+	size_t i;
+	if (bvh->is_leaf) {
+		for (i = active[0]; i < active[1]; i++)
+			leaf_get_closest_intersection(bvh->children[0].object, &packet->rays[i], &closest_objects[i], closest_normals[i], &closest_distances[i]);
+		return;
+	}
+
+	size_t child_active[2][2];
+	bool intersects[2];
+	float tmin[2];
+	for (i = 0; i < 2; i++) {
+		child_active[i][0] = active[0];
+		child_active[i][1] = active[1];
+		STAT_CACHE_ACCESS(bvh->children[i].bvh);
+		intersects[i] = ray_packet_get_active(bvh->children[i].bvh->bounding_cuboid, packet, child_active[i], closest_distances, &tmin[i]);
+	}
+	const size_t near = !intersects[0] || (intersects[1] && (child_active[1][0] < child_active[0][0] || (child_active[1][0] == child_active[0][0] && tmin[1] < tmin[0])));
+	if (intersects[near])
+		bvh_get_closest_intersections(bvh->children[near].bvh, packet, child_active[near], closest_objects, closest_normals, closest_distances);
+	if (intersects[!near])
+		bvh_get_closest_intersections(bvh->children[!near].bvh, packet, child_active[!near], closest_objects, closest_normals, closest_distances);
+}
+
+bool accel_is_light_blocked(const struct Ray *ray, const float distance, v3 light_intensity, const struct Object *emittant_object)
+{
+	num_transparent_hits = 0;
+#ifdef QUANTIZED_BVH
+	return qbvh_is_light_blocked(qbvh_root, ray, distance, light_intensity, emittant_object);
+#else
+	return bvh_is_light_blocked(accel, ray, distance, light_intensity, emittant_object);
+#endif
+}
+
+bool leaf_is_light_blocked(const struct Object *object, const struct Ray *ray, const float distance, v3 light_intensity, const struct Object *emittant_object)
+{
+	v3 normal;
+	float tmin;
+	if (object == emittant_object)
 		return false;
+	STAT_INC(STAT_PRIMITIVE_TESTS);
+	STAT_CACHE_ACCESS(object);
+	accel_traversal_cost++;
+	if (object_get_intersection(object, ray, &tmin, normal) && tmin < distance) {
+		STAT_INC_HIT(object->object_data->type);
+		if (!object->material->transparent)
+			return true;
+		size_t i;
+		for (i = 0; i < num_transparent_hits; i++)
+			if (transparent_hits[i] == object)
+				return false;
+		if (num_transparent_hits < ACCEL_MAX_TRANSPARENT_HITS)
+			transparent_hits[num_transparent_hits++] = object;
+		mul3v(light_intensity, object->material->kt, light_intensity);
 	}
+	return false;
+}
+
+bool bvh_is_light_blocked(const struct BVH *bvh, const struct Ray *ray, const float distance, v3 light_intensity, const struct Object *emittant_object)
+{
+	float tmin, tmax;
+
+	STAT_INC(STAT_BVH_NODES_VISITED);
+	STAT_CACHE_ACCESS(bvh);
+
+	if (bvh->is_leaf)
+		return leaf_is_light_blocked(bvh->children[0].object, ray, distance, light_intensity, emittant_object);
 
 	size_t i;
 #pragma GCC unroll 2
 	for (i = 0; i < 2; i++) {
+		STAT_CACHE_ACCESS(bvh->children[i].bvh);
 		if (bounding_cuboid_intersects(bvh->children[i].bvh->bounding_cuboid, ray, &tmax, &tmin)
 			&& tmin < distance
 			&& bvh_is_light_blocked(bvh->children[i].bvh, ray, distance, light_intensity, emittant_object))
@@ -386,6 +1211,242 @@ bool bvh_is_light_blocked(const struct BVH *bvh, const struct Ray *ray, const fl
 	return false;
 }
 
+#ifdef QUANTIZED_BVH
+void qbvh_init(const size_t num_leaves)
+{
+	error_check(num_leaves < QBVH_LEAF, "Exceeded maximum number of objects [%u] in quantized BVH.", QBVH_LEAF);
+	qbvh_nodes = safe_malloc(sizeof(struct QBVHNode) * (num_leaves > 1 ? num_leaves - 1 : 1));
+	qbvh_leaves = safe_malloc(sizeof(struct Object *) * num_leaves);
+	num_qbvh_nodes = 0;
+	num_qbvh_leaves = 0;
+}
+
+//Quantizes BVH built by SBVH
+uint32_t qbvh_convert_node(const struct BVH *bvh)
+{
+	if (bvh->is_leaf) {
+		qbvh_leaves[num_qbvh_leaves] = bvh->children[0].object;
+		return QBVH_LEAF | (uint32_t)num_qbvh_leaves++;
+	}
+
+	uint32_t node_ref = (uint32_t)num_qbvh_nodes++;
+	const struct BoundingCuboid child_cuboids[2] = { *bvh->children[0].bvh->bounding_cuboid, *bvh->children[1].bvh->bounding_cuboid };
+	qbvh_quantize(&qbvh_nodes[node_ref], bvh->bounding_cuboid, child_cuboids);
+	uint32_t child_left = qbvh_convert_node(bvh->children[0].bvh);
+	uint32_t child_right = qbvh_convert_node(bvh->children[1].bvh);
+	qbvh_nodes[node_ref].children[0] = child_left;
+	qbvh_nodes[node_ref].children[1] = child_right;
+	return node_ref;
+}
+
+//Equivalent to bvh_generate_node. Returns reference to node, with QBVH_LEAF set if it is a leaf. Nodes are stored in depth-first order
+uint32_t qbvh_generate_node(const struct BVHWithMorton *leaf_array, const size_t first, const size_t last, struct BoundingCuboid *cuboid)
+{
+	if (first == last) {
+		*cuboid = *leaf_array[first].bvh->bounding_cuboid;
+		qbvh_leaves[num_qbvh_leaves] = leaf_array[first].bvh->children[0].object;
+		return QBVH_LEAF | (uint32_t)num_qbvh_leaves++;
+	}
+
+	size_t split = bvh_find_split(leaf_array, first, last);
+	uint32_t node_ref = (uint32_t)num_qbvh_nodes++;
+	struct BoundingCuboid child_cuboids[2];
+	uint32_t child_left = qbvh_generate_node(leaf_array, first, split, &child_cuboids[0]);
+	uint32_t child_right = qbvh_generate_node(leaf_array, split + 1, last, &child_cuboids[1]);
+	bounding_cuboid_merge(&child_cuboids[0], &child_cuboids[1], cuboid);
+
+	struct QBVHNode *node = &qbvh_nodes[node_ref];
+	qbvh_quantize(node, cuboid, child_cuboids);
+	node->children[0] = child_left;
+	node->children[1] = child_right;
+	return node_ref;
+}
+
+//Rounds bounds outwards, so that decoded child cuboids always contain the original ones
+void qbvh_quantize(struct QBVHNode *node, const struct BoundingCuboid *cuboid, const struct BoundingCuboid child_cuboids[2])
+{
+	assign3(node->origin, cuboid->corners[0]);
+	size_t i, j;
+	for (j = 0; j < 3; j++) {
+		float scale = (cuboid->corners[1][j] - cuboid->corners[0][j]) / QBVH_MAX_BOUND;
+		while (node->origin[j] + QBVH_MAX_BOUND * scale < cuboid->corners[1][j])
+			scale = nextafterf(scale, INFINITY);
+		node->scale[j] = scale;
+	}
+
+	for (i = 0; i < 2; i++) {
+		node->epsilon[i] = child_cuboids[i].epsilon;
+		for (j = 0; j < 3; j++) {
+			float scale = node->scale[j];
+			float min = 0.f, max = 0.f;
+			if (scale > 0.f) {
+				min = fmaxf(floorf((child_cuboids[i].corners[0][j] - node->origin[j]) / scale), 0.f);
+				max = fminf(ceilf((child_cuboids[i].corners[1][j] - node->origin[j]) / scale), QBVH_MAX_BOUND);
+				while (min > 0.f && node->origin[j] + min * scale > child_cuboids[i].corners[0][j])
+					min--;
+				while (max < QBVH_MAX_BOUND && node->origin[j] + max * scale < child_cuboids[i].corners[1][j])
+					max++;
+			}
+			node->bounds[i][0][j] = (qbvh_bound_t)min;
+			node->bounds[i][1][j] = (qbvh_bound_t)max;
+		}
+	}
+}
+
+//Equivalent to bvh_refit. Quantizes nodes again relative to their refit bounds
+void qbvh_refit(const uint32_t node_ref, struct BoundingCuboid *cuboid)
+{
+	if (node_ref & QBVH_LEAF) {
+		const struct Object *object = qbvh_leaves[node_ref & ~QBVH_LEAF];
+		object_get_corners(object, cuboid->corners);
+		cuboid->epsilon = object->epsilon;
+		return;
+	}
+
+	struct QBVHNode *node = &qbvh_nodes[node_ref];
+	struct BoundingCuboid child_cuboids[2];
+	qbvh_refit(node->children[0], &child_cuboids[0]);
+	qbvh_refit(node->children[1], &child_cuboids[1]);
+	bounding_cuboid_merge(&child_cuboids[0], &child_cuboids[1], cuboid);
+	qbvh_quantize(node, cuboid, child_cuboids);
+}
+
+//Sum of surface areas of decoded bounding cuboids of all descendants of node
+float qbvh_get_area(const uint32_t node_ref)
+{
+	if (node_ref & QBVH_LEAF)
+		return 0.f;
+
+	const struct QBVHNode *node = &qbvh_nodes[node_ref];
+	float area = 0.f;
+	size_t i, j;
+	for (i = 0; i < 2; i++) {
+		struct BoundingCuboid cuboid;
+		for (j = 0; j < 3; j++) {
+			cuboid.corners[0][j] = node->origin[j] + node->bounds[i][0][j] * node->scale[j];
+			cuboid.corners[1][j] = node->origin[j] + node->bounds[i][1][j] * node->scale[j];
+		}
+		area += bounding_cuboid_area(&cuboid) + qbvh_get_area(node->children[i]);
+	}
+	return area;
+}
+
+//Equivalent to SAH cost printed by bvh_print_metrics
+float qbvh_get_sah_cost(void)
+{
+	if (qbvh_root & QBVH_LEAF)
+		return 1.f;
+
+	const struct QBVHNode *root = &qbvh_nodes[qbvh_root];
+	struct BoundingCuboid cuboid;
+	assign3(cuboid.corners[0], root->origin);
+	mul3s(root->scale, QBVH_MAX_BOUND, cuboid.corners[1]);
+	add3v(cuboid.corners[1], root->origin, cuboid.corners[1]);
+	float area = bounding_cuboid_area(&cuboid);
+	return (area + qbvh_get_area(qbvh_root)) / fmaxf(area, FLT_MIN);
+}
+
+//Slab test of both children, which decodes bounds as (origin - point + bound * scale) / direction
+void qbvh_intersects(const struct QBVHNode *node, const struct Ray *ray, bool intersects[2], float tmin[2])
+{
+	STAT_CACHE_ACCESS(node);
+	v3 offset, step;
+	bool negative[3];
+	size_t i, j;
+	for (j = 0; j < 3; j++) {
+		float div = 1 / ray->direction[j];
+		offset[j] = (node->origin[j] - ray->point[j]) * div;
+		step[j] = node->scale[j] * div;
+		negative[j] = div < 0;
+	}
+
+#pragma GCC unroll 2
+	for (i = 0; i < 2; i++) {
+		STAT_INC(STAT_BOX_TESTS);
+		accel_traversal_cost++;
+
+		v3 t[2];
+		for (j = 0; j < 3; j++) {
+			float t_min = offset[j] + node->bounds[i][0][j] * step[j];
+			float t_max = offset[j] + node->bounds[i][1][j] * step[j];
+			t[0][j] = negative[j] ? t_max : t_min;
+			t[1][j] = negative[j] ? t_min : t_max;
+		}
+
+		float tmin_i = t[0][X], tmax = t[1][X];
+		intersects[i] = false;
+		if (tmin_i > t[1][Y] || t[0][Y] > tmax)
+			continue;
+		if (t[0][Y] > tmin_i)
+			tmin_i = t[0][Y];
+		if (t[1][Y] < tmax)
+			tmax = t[1][Y];
+		if (tmin_i > t[1][Z] || t[0][Z] > tmax)
+			continue;
+		if (t[0][Z] > tmin_i)
+			tmin_i = t[0][Z];
+		if (t[1][Z] < tmax)
+			tmax = t[1][Z];
+		tmin[i] = tmin_i;
+		intersects[i] = tmax > node->epsilon[i];
+	}
+}
+
+void qbvh_get_closest_intersection(const uint32_t node_ref, const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance)
+{
+	STAT_INC(STAT_BVH_NODES_VISITED);
+
+	if (node_ref & QBVH_LEAF) {
+		leaf_get_closest_intersection(qbvh_leaves[node_ref & ~QBVH_LEAF], ray, closest_object, closest_normal, closest_distance);
+		return;
+	}
+
+	const struct QBVHNode *node = &qbvh_nodes[node_ref];
+	bool intersects[2];
+	float tmin[2];
+	qbvh_intersects(node, ray, intersects, tmin);
+
+	bool intersect_l = intersects[0] && tmin[0] < *closest_distance;
+	bool intersect_r = intersects[1] && tmin[1] < *closest_distance;
+	if (intersect_l && intersect_r) {
+		if (tmin[0] < tmin[1]) {
+			qbvh_get_closest_intersection(node->children[0], ray, closest_object, closest_normal, closest_distance);
+			qbvh_get_closest_intersection(node->children[1], ray, closest_object, closest_normal, closest_distance);
+		} else {
+			qbvh_get_closest_intersection(node->children[1], ray, closest_object, closest_normal, closest_distance);
+			qbvh_get_closest_intersection(node->children[0], ray, closest_object, closest_normal, closest_distance);
+		}
+	} else if (intersect_l) {
+		qbvh_get_closest_intersection(node->children[0], ray, closest_object, closest_normal, closest_distance);
+	} else if (intersect_r) {
+		qbvh_get_closest_intersection(node->children[1], ray, closest_object, closest_normal, closest_distance);
+	}
+}
+
+bool qbvh_is_light_blocked(const uint32_t node_ref, const struct Ray *ray, const float distance, v3 light_intensity, const struct Object *emittant_object)
+{
+	STAT_INC(STAT_BVH_NODES_VISITED);
+
+	if (node_ref & QBVH_LEAF)
+		return leaf_is_light_blocked(qbvh_leaves[node_ref & ~QBVH_LEAF], ray, distance, light_intensity, emittant_object);
+
+	const struct QBVHNode *node = &qbvh_nodes[node_ref];
+	bool intersects[2];
+	float tmin[2];
+	qbvh_intersects(node, ray, intersects, tmin);
+
+	size_t i;
+#pragma GCC unroll 2
+	for (i = 0; i < 2; i++) {
+		if (intersects[i]
+			&& tmin[i] < distance
+			&& qbvh_is_light_blocked(node->children[i], ray, distance, light_intensity, emittant_object))
+			return true;
+	}
+	return false;
+}
+#endif /* QUANTIZED_BVH */
+
 #ifdef DEBUG
 void bvh_print(const struct BVH *bvh, const uint32_t depth)
 {
@@ -16,14 +16,29 @@
 
 struct Ray;
 struct Object;
+struct BoundingCuboid;
+
+#define ACCEL_MAX_PACKET_RAYS 16
 
 void accel_init(void);
 void accel_deinit(void);
+/* Requires objects which moved to be updated */
+void accel_update(void);
 
 void accel_get_closest_intersection(const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance);
+/* Traverses coherent rays together as a packet, or one at a time if their directions diverge */
+void accel_get_closest_intersections(const struct Ray *rays, size_t num_rays, struct Object **closest_objects, v3 *closest_normals, float *closest_distances);
 bool accel_is_light_blocked(const struct Ray *ray, const float distance, v3 light_intensity, const struct Object *emittant_object);
+
+/* 30-bit Morton code of point in cube [0,1] */
+uint32_t morton_code(const v3 vec);
+
+struct BoundingCuboid *bounding_cuboid_new(float epsilon, v3 corners[2]);
+bool bounding_cuboid_intersects(const struct BoundingCuboid *cuboid, const struct Ray *ray, float *tmax, float *tmin);
 #ifdef DEBUG
 void accel_print(uint32_t depth);
 #endif
 
+extern _Thread_local uint32_t accel_traversal_cost; //Bounding cuboids and primitives tested by the calling thread
+
 #endif /* __ACCEL_H__ */
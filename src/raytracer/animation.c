@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2021-2022 Wojciech Graj
+ *
+ * Licensed under the MIT license: https://opensource.org/licenses/MIT
+ * Permission is granted to use, copy, modify, and redistribute the work.
+ * Full license information available in the project LICENSE file.
+ *
+ * DESCRIPTION:
+ *   Keyframed transforms of objects over a sequence of frames
+ **/
+
+#include "animation.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "argv.h"
+#include "calc.h"
+#include "camera.h"
+#include "error.h"
+#include "mem.h"
+#include "object.h"
+
+struct Animation {
+	size_t first_object;
+	size_t num_objects;
+	struct Keyframe *keyframes;
+	size_t num_keyframes;
+	float (*parameters)[OBJECT_MAX_PARAMETERS]; //Parameters of objects in the scene, which keyframes are relative to
+	v3 pivot;
+	v3 position; //Current pose
+	v3 rotation;
+	v3 end_position; //Pose when the shutter closes
+	v3 end_rotation;
+	struct Motion motion;
+};
+
+struct CameraAnimation {
+	struct Keyframe *keyframes; //NULL if camera is not animated
+	size_t num_keyframes;
+	v3 position; //Camera in the scene, which keyframes are relative to
+	v3 vectors[3];
+	v3 current_position; //Current pose
+	v3 current_rotation;
+};
+
+void animation_apply(struct Animation *animation, const v3 position, const v3 rotation, const v3 end_position, const v3 end_rotation);
+void animation_get_motion(struct Animation *animation);
+void keyframes_get_pose(const struct Keyframe *keyframes, size_t num_keyframes, float time, v3 position, v3 rotation);
+void animation_camera_apply(const v3 position, const v3 rotation);
+
+static struct Animation *animations;
+static size_t num_animations;
+static struct CameraAnimation camera_animation;
+uint32_t num_frames = 1;
+float shutter;
+
+void animation_add(const size_t first_object, const size_t num_animated_objects, const struct Keyframe *keyframes, const size_t num_keyframes)
+{
+	animations = safe_realloc(animations, sizeof(struct Animation) * (num_animations + 1));
+	struct Animation *animation = &animations[num_animations++];
+	*animation = (struct Animation){
+		.first_object = first_object,
+		.num_objects = num_animated_objects,
+		.keyframes = safe_malloc(sizeof(struct Keyframe) * num_keyframes),
+		.num_keyframes = num_keyframes,
+	};
+	memcpy(animation->keyframes, keyframes, sizeof(struct Keyframe) * num_keyframes);
+}
+
+void animation_add_camera(const struct Keyframe *keyframes, const size_t num_keyframes)
+{
+	camera_animation.keyframes = safe_malloc(sizeof(struct Keyframe) * num_keyframes);
+	camera_animation.num_keyframes = num_keyframes;
+	memcpy(camera_animation.keyframes, keyframes, sizeof(struct Keyframe) * num_keyframes);
+}
+
+void animation_scale(const float scale)
+{
+	size_t i, j;
+	for (i = 0; i < num_animations; i++)
+		for (j = 0; j < animations[i].num_keyframes; j++)
+			mul3s(animations[i].keyframes[j].position, scale, animations[i].keyframes[j].position);
+	for (j = 0; j < camera_animation.num_keyframes; j++)
+		mul3s(camera_animation.keyframes[j].position, scale, camera_animation.keyframes[j].position);
+}
+
+void animation_init(void)
+{
+	int idx = argv_check_with_args("--frames", 1);
+	if (idx) {
+		num_frames = abs(atoi(myargv[idx + 1]));
+		error_check(num_frames, "Expected nonzero number of frames.");
+	}
+
+	idx = argv_check_with_args("--shutter", 1);
+	if (idx) {
+		shutter = atof(myargv[idx + 1]);
+		error_check(shutter >= 0.f, "Expected nonnegative shutter interval [%f].", (double)shutter);
+	}
+
+	if (camera_animation.keyframes) {
+		assign3(camera_animation.position, camera.position);
+		memcpy(camera_animation.vectors, camera.vectors, sizeof(v3[3]));
+		v3 position, rotation;
+		keyframes_get_pose(camera_animation.keyframes, camera_animation.num_keyframes, 0.f, position, rotation);
+		animation_camera_apply(position, rotation);
+	}
+
+	if (!num_animations)
+		return;
+	printf_log("Initializing %zu animations.", num_animations);
+
+	size_t i, j;
+	for (i = 0; i < num_animations; i++) {
+		struct Animation *animation = &animations[i];
+		animation->parameters = safe_malloc(sizeof(float[OBJECT_MAX_PARAMETERS]) * animation->num_objects);
+
+		v3 corners[2] = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+		for (j = 0; j < animation->num_objects; j++) {
+			struct Object *object = objects[animation->first_object + j];
+			object->object_data->get_parameters(object, animation->parameters[j]);
+			object->is_animated = true;
+#ifdef UNBOUND_OBJECTS
+			if (!object->object_data->is_bounded) { //Planes rotate about their point closest to the origin
+				mul3s(animation->parameters[j], animation->parameters[j][3], corners[0]);
+				assign3(corners[1], corners[0]);
+				break;
+			}
+#endif
+			v3 object_corners[2];
+			object->object_data->get_corners(object, object_corners);
+			size_t k;
+			for (k = 0; k < 3; k++) {
+				corners[0][k] = fminf(corners[0][k], object_corners[0][k]);
+				corners[1][k] = fmaxf(corners[1][k], object_corners[1][k]);
+			}
+		}
+		add3v(corners[0], corners[1], animation->pivot);
+		mul3s(animation->pivot, 0.5f, animation->pivot);
+
+		v3 position, rotation, end_position, end_rotation;
+		keyframes_get_pose(animation->keyframes, animation->num_keyframes, 0.f, position, rotation);
+		keyframes_get_pose(animation->keyframes, animation->num_keyframes, shutter, end_position, end_rotation);
+		animation_apply(animation, position, rotation, end_position, end_rotation);
+	}
+}
+
+void animation_deinit(void)
+{
+	size_t i;
+	for (i = 0; i < num_animations; i++) {
+		free(animations[i].keyframes);
+		free(animations[i].parameters);
+	}
+	free(animations);
+	free(camera_animation.keyframes);
+}
+
+//Linearly interpolates between keyframes
+void keyframes_get_pose(const struct Keyframe *keyframes, const size_t num_keyframes, const float time, v3 position, v3 rotation)
+{
+	size_t last = num_keyframes - 1;
+	if (time <= keyframes[0].time || !last) {
+		assign3(position, keyframes[0].position);
+		assign3(rotation, keyframes[0].rotation);
+		return;
+	}
+	if (time >= keyframes[last].time) {
+		assign3(position, keyframes[last].position);
+		assign3(rotation, keyframes[last].rotation);
+		return;
+	}
+
+	size_t i = 1;
+	while (keyframes[i].time < time)
+		i++;
+	float t = (time - keyframes[i - 1].time) / (keyframes[i].time - keyframes[i - 1].time);
+	size_t j;
+	for (j = 0; j < 3; j++) {
+		position[j] = keyframes[i - 1].position[j] + t * (keyframes[i].position[j] - keyframes[i - 1].position[j]);
+		rotation[j] = keyframes[i - 1].rotation[j] + t * (keyframes[i].rotation[j] - keyframes[i - 1].rotation[j]);
+	}
+}
+
+//Rotates objects about pivot, then translates them by position. Objects move towards their end pose while the shutter is open
+void animation_apply(struct Animation *animation, const v3 position, const v3 rotation, const v3 end_position, const v3 end_rotation)
+{
+	assign3(animation->position, position);
+	assign3(animation->rotation, rotation);
+	assign3(animation->end_position, end_position);
+	assign3(animation->end_rotation, end_rotation);
+	animation_get_motion(animation);
+	const struct Motion *motion = (animation->motion.angle || animation->motion.translation[X] || animation->motion.translation[Y] || animation->motion.translation[Z]) ? &animation->motion : NULL;
+
+	m3 transform;
+	mesh_get_transform(rotation, 1.f, transform);
+	v3 translation;
+	mulmv(transform, animation->pivot, translation);
+	sub3v(animation->pivot, translation, translation);
+	add3v(translation, position, translation);
+
+	const size_t first_object = animation->first_object;
+	float(*parameters)[OBJECT_MAX_PARAMETERS] = animation->parameters;
+#ifdef MULTITHREADING
+#pragma omp parallel for if (animation->num_objects > 1024)
+#endif
+	for (size_t i = 0; i < animation->num_objects; i++) {
+		struct Object *object = objects[first_object + i];
+		object->object_data->transform(object, parameters[i], transform, translation);
+		object->motion = motion;
+	}
+}
+
+//Rotation from pose when the shutter opens to pose when it closes, as angle about axis
+void animation_get_motion(struct Animation *animation)
+{
+	struct Motion *motion = &animation->motion;
+	add3v(animation->pivot, animation->position, motion->center);
+	sub3v(animation->end_position, animation->position, motion->translation);
+
+	m3 start, end, rotation;
+	mesh_get_transform(animation->rotation, 1.f, start);
+	mesh_get_transform(animation->end_rotation, 1.f, end);
+	size_t i, j;
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++) //end * transpose(start)
+			rotation[i][j] = end[i][X] * start[j][X] + end[i][Y] * start[j][Y] + end[i][Z] * start[j][Z];
+
+	v3 axis = { rotation[Z][Y] - rotation[Y][Z], rotation[X][Z] - rotation[Z][X], rotation[Y][X] - rotation[X][Y] };
+	float axis_mag = mag3(axis);
+	if (axis_mag < 1e-6f) { //No rotation. Half a turn or more while the shutter is open is not supported
+		motion->angle = 0.f;
+		assign3(motion->axis, ((v3){ 1.f, 0.f, 0.f }));
+		return;
+	}
+	mul3s(axis, 1.f / axis_mag, motion->axis);
+	motion->angle = atan2f(0.5f * axis_mag, 0.5f * (rotation[X][X] + rotation[Y][Y] + rotation[Z][Z] - 1.f));
+}
+
+bool animation_update(const float time)
+{
+	bool moved = false;
+	size_t i;
+	for (i = 0; i < num_animations; i++) {
+		struct Animation *animation = &animations[i];
+		v3 position, rotation, end_position, end_rotation;
+		keyframes_get_pose(animation->keyframes, animation->num_keyframes, time, position, rotation);
+		keyframes_get_pose(animation->keyframes, animation->num_keyframes, time + shutter, end_position, end_rotation);
+		if (!memcmp(position, animation->position, sizeof(v3)) && !memcmp(rotation, animation->rotation, sizeof(v3))
+			&& !memcmp(end_position, animation->end_position, sizeof(v3)) && !memcmp(end_rotation, animation->end_rotation, sizeof(v3)))
+			continue;
+		animation_apply(animation, position, rotation, end_position, end_rotation);
+		moved = true;
+	}
+	return moved;
+}
+
+//Rotates camera about its position, then translates it by position
+void animation_camera_apply(const v3 position, const v3 rotation)
+{
+	assign3(camera_animation.current_position, position);
+	assign3(camera_animation.current_rotation, rotation);
+
+	m3 transform;
+	mesh_get_transform(rotation, 1.f, transform);
+	add3v(camera_animation.position, position, camera.position);
+	size_t i;
+	for (i = 0; i < 3; i++)
+		mulmv(transform, camera_animation.vectors[i], camera.vectors[i]);
+}
+
+bool animation_update_camera(const float time)
+{
+	if (!camera_animation.keyframes)
+		return false;
+	v3 position, rotation;
+	keyframes_get_pose(camera_animation.keyframes, camera_animation.num_keyframes, time, position, rotation);
+	if (!memcmp(position, camera_animation.current_position, sizeof(v3)) && !memcmp(rotation, camera_animation.current_rotation, sizeof(v3)))
+		return false;
+	animation_camera_apply(position, rotation);
+	return true;
+}
+
+void animation_get_filename(const uint32_t frame, char *filename, const size_t size)
+{
+	const char *output_filename = myargv[ARG_OUTPUT_FILENAME];
+	if (num_frames == 1) {
+		snprintf(filename, size, "%s", output_filename);
+		return;
+	}
+
+	const char *extension = strrchr(output_filename, '.');
+	int length = extension ? (int)(extension - output_filename) : (int)strlen(output_filename);
+	snprintf(filename, size, "%.*s_%04u%s", length, output_filename, frame, extension ? extension : "");
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2021-2022 Wojciech Graj
+ *
+ * Licensed under the MIT license: https://opensource.org/licenses/MIT
+ * Permission is granted to use, copy, modify, and redistribute the work.
+ * Full license information available in the project LICENSE file.
+ *
+ * DESCRIPTION:
+ *   Keyframed transforms of objects over a sequence of frames
+ **/
+
+#ifndef __ANIMATION_H__
+#define __ANIMATION_H__
+
+#include <stddef.h>
+
+#include "type.h"
+
+struct Keyframe {
+	float time; //In frames
+	v3 position; //Offset from position in scene
+	v3 rotation; //Rotation about the X, Y, then Z axis, around the center of the object's bounding cuboid in the scene
+};
+
+/* Animates num_animated_objects objects starting at objects[first_object]. Keyframes are copied and must be sorted by time */
+void animation_add(size_t first_object, size_t num_animated_objects, const struct Keyframe *keyframes, size_t num_keyframes);
+/* Animates camera. Rotation is about the camera's position */
+void animation_add_camera(const struct Keyframe *keyframes, size_t num_keyframes);
+void animation_scale(float scale);
+
+/* Requires camera and objects to be loaded and scaled. Moves them to their pose in the first frame */
+void animation_init(void);
+void animation_deinit(void);
+
+/* Moves objects to their pose at time. Returns true if any object moved */
+bool animation_update(float time);
+/* Moves camera to its pose at time. Returns true if it moved */
+bool animation_update_camera(float time);
+
+/* Output filename of frame, which is numbered if there are multiple frames */
+void animation_get_filename(uint32_t frame, char *filename, size_t size);
+
+extern uint32_t num_frames;
+extern float shutter; //Fraction of a frame during which animated objects are blurred. 0 if motion blur is disabled
+
+#endif /* __ANIMATION_H__ */
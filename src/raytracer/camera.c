@@ -16,7 +16,7 @@
 
 struct Camera camera;
 
-void camera_init(const v3 position, v3 vectors[2], const float fov, const float focal_length)
+void camera_init(const v3 position, v3 vectors[2], const float fov, const float focal_length, const float aperture, const float focus_distance)
 {
 	printf_log("Initializing camera.");
 
@@ -25,6 +25,11 @@ void camera_init(const v3 position, v3 vectors[2], const float fov, const float
 	camera.fov = fov;
 	camera.focal_length = focal_length;
 
+	error_check(aperture >= 0.f, "Expected nonnegative camera aperture [%f].", (double)aperture);
+	error_check(focus_distance > 0.f, "Expected positive camera focus distance [%f].", (double)focus_distance);
+	camera.aperture = aperture;
+	camera.focus_distance = focus_distance;
+
 	assign3(camera.position, position);
 	memcpy(camera.vectors, vectors, sizeof(v3[2]));
 	norm3(camera.vectors[0]);
@@ -37,4 +42,6 @@ void camera_scale(const v3 neg_shift, const float scale)
 	sub3v(camera.position, neg_shift, camera.position);
 	mul3s(camera.position, scale, camera.position);
 	camera.focal_length *= scale;
+	camera.aperture *= scale;
+	camera.focus_distance *= scale;
 }
@@ -19,9 +19,11 @@ struct Camera {
 	v3 vectors[3]; //vectors are perpendicular to eachother and normalized. vectors[3] is normal to projection_plane.
 	float fov;
 	float focal_length;
+	float aperture; //Diameter of lens. 0 for a pinhole camera
+	float focus_distance; //From lens to plane in focus, along vectors[2]
 };
 
-void camera_init(const v3 position, v3 vectors[2], float fov, float focal_length);
+void camera_init(const v3 position, v3 vectors[2], float fov, float focal_length, float aperture, float focus_distance);
 void camera_scale(const v3 neg_shift, float scale);
 
 extern struct Camera camera;
@@ -13,6 +13,7 @@
 
 #include <float.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -25,11 +26,26 @@
 #include <tiffio.h>
 
 #define TIFFTAG_Z_BUFFER 65000
+#define TIFFTAG_NORMAL_BUFFER 65001
+#define TIFFTAG_ALBEDO_BUFFER 65002
+#define TIFFTAG_MATERIAL_BUFFER 65003
+#define TIFFTAG_OBJECT_BUFFER 65004
+#define TIFFTAG_RAY_COUNT_BUFFER 65005
 
-void save_tiff_raw(TIFF *tif);
-void save_tiff(TIFF *tif);
+void image_buffers_init(struct Image *buffers, bool aov, bool heatmap);
+void image_buffers_deinit(struct Image *buffers);
+void heatmap_to_raster(struct Image *buffers);
+void save_tiff_aov(TIFF *tif, const struct Image *buffers);
+void save_tiff_raw(TIFF *tif, const struct Image *buffers);
+void save_tiff(TIFF *tif, const struct Image *buffers);
+void save_image_buffers(struct Image *buffers, const char *filename);
+void *save_frame_thread(void *arg);
 
 struct Image image;
+static struct Image saved_frame; //Buffers of previous frame, which are saved while the next frame is rendered into image
+static char saved_frame_filename[FILENAME_MAX];
+static pthread_t save_frame_thread_id;
+static bool is_saving_frame;
 
 void image_init(void)
 {
@@ -42,9 +58,12 @@ void image_init(void)
 	image.size[X] = 2 * camera.focal_length * tanf(camera.fov * PI / 360.f);
 	image.size[Y] = image.size[X] * image.resolution[Y] / image.resolution[X];
 
-	image.raster = safe_malloc(image.pixels * sizeof(v3));
-	image.z_buffer = safe_malloc(image.pixels * sizeof(float));
+	image_buffers_init(&image, argv_check("--aov"), argv_check("--heatmap"));
+	image_update_camera();
+}
 
+void image_update_camera(void)
+{
 	v3 focal_vector, plane_center, corner_offset_vectors[2];
 	mul3s(camera.vectors[2], camera.focal_length, focal_vector);
 	add3v(focal_vector, camera.position, plane_center);
@@ -55,13 +74,82 @@ void image_init(void)
 	add3v3(plane_center, corner_offset_vectors[X], corner_offset_vectors[Y], image.corner);
 }
 
+void image_buffers_init(struct Image *buffers, const bool aov, const bool heatmap)
+{
+	buffers->raster = safe_calloc(image.pixels, sizeof(v3));
+	buffers->z_buffer = safe_malloc(image.pixels * sizeof(float));
+
+	if (aov) {
+		buffers->normal_buffer = safe_malloc(image.pixels * sizeof(v3));
+		buffers->albedo_buffer = safe_malloc(image.pixels * sizeof(v3));
+		buffers->material_buffer = safe_malloc(image.pixels * sizeof(int32_t));
+		buffers->object_buffer = safe_malloc(image.pixels * sizeof(int32_t));
+		buffers->ray_count_buffer = safe_malloc(image.pixels * sizeof(uint32_t));
+	}
+
+	if (heatmap)
+		buffers->cost_buffer = safe_malloc(image.pixels * sizeof(uint32_t));
+}
+
+void image_buffers_deinit(struct Image *buffers)
+{
+	free(buffers->raster);
+	free(buffers->z_buffer);
+	free(buffers->normal_buffer);
+	free(buffers->albedo_buffer);
+	free(buffers->material_buffer);
+	free(buffers->object_buffer);
+	free(buffers->ray_count_buffer);
+	free(buffers->cost_buffer);
+}
+
 void image_deinit(void)
 {
-	free(image.raster);
-	free(image.z_buffer);
+	save_frame_wait();
+	image_buffers_deinit(&image);
+	image_buffers_deinit(&saved_frame);
+}
+
+//Replaces raster with false-color traversal cost, ranging from blue (cheapest) to red (most expensive)
+void heatmap_to_raster(struct Image *buffers)
+{
+	uint32_t max_cost = 1;
+	uint64_t total_cost = 0;
+	size_t i;
+	for (i = 0; i < image.pixels; i++) {
+		if (buffers->cost_buffer[i] > max_cost)
+			max_cost = buffers->cost_buffer[i];
+		total_cost += buffers->cost_buffer[i];
+	}
+	printf_log("Traversal cost per pixel: mean [%f], max [%u].", (double)total_cost / image.pixels, max_cost);
+
+	for (i = 0; i < image.pixels; i++) {
+		float t = 4.f * buffers->cost_buffer[i] / max_cost;
+		buffers->raster[i][0] = clamp(1.5f - fabsf(t - 3.f), 0.f, 1.f);
+		buffers->raster[i][1] = clamp(1.5f - fabsf(t - 2.f), 0.f, 1.f);
+		buffers->raster[i][2] = clamp(1.5f - fabsf(t - 1.f), 0.f, 1.f);
+	}
+}
+
+void save_tiff_aov(TIFF *tif, const struct Image *buffers)
+{
+	static const TIFFFieldInfo xtiffFieldInfo[] = {
+		{ TIFFTAG_NORMAL_BUFFER, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_FLOAT, FIELD_CUSTOM, true, true, "NormalBuffer" },
+		{ TIFFTAG_ALBEDO_BUFFER, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_FLOAT, FIELD_CUSTOM, true, true, "AlbedoBuffer" },
+		{ TIFFTAG_MATERIAL_BUFFER, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_SLONG, FIELD_CUSTOM, true, true, "MaterialBuffer" },
+		{ TIFFTAG_OBJECT_BUFFER, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_SLONG, FIELD_CUSTOM, true, true, "ObjectBuffer" },
+		{ TIFFTAG_RAY_COUNT_BUFFER, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_LONG, FIELD_CUSTOM, true, true, "RayCountBuffer" },
+	};
+
+	TIFFMergeFieldInfo(tif, xtiffFieldInfo, arrlen(xtiffFieldInfo));
+	TIFFSetField(tif, TIFFTAG_NORMAL_BUFFER, image.pixels * 3, buffers->normal_buffer);
+	TIFFSetField(tif, TIFFTAG_ALBEDO_BUFFER, image.pixels * 3, buffers->albedo_buffer);
+	TIFFSetField(tif, TIFFTAG_MATERIAL_BUFFER, image.pixels, buffers->material_buffer);
+	TIFFSetField(tif, TIFFTAG_OBJECT_BUFFER, image.pixels, buffers->object_buffer);
+	TIFFSetField(tif, TIFFTAG_RAY_COUNT_BUFFER, image.pixels, buffers->ray_count_buffer);
 }
 
-void save_tiff_raw(TIFF *tif)
+void save_tiff_raw(TIFF *tif, const struct Image *buffers)
 {
 	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 32);
 
@@ -70,21 +158,21 @@ void save_tiff_raw(TIFF *tif)
 	};
 
 	TIFFMergeFieldInfo(tif, xtiffFieldInfo, arrlen(xtiffFieldInfo));
-	TIFFSetField(tif, TIFFTAG_Z_BUFFER, image.pixels, image.z_buffer);
+	TIFFSetField(tif, TIFFTAG_Z_BUFFER, image.pixels, buffers->z_buffer);
 
 	tdata_t buf;
 	tstrip_t strip;
 
 	buf = _TIFFmalloc(TIFFStripSize(tif));
 	for (strip = 0; strip < TIFFNumberOfStrips(tif); strip++) {
-		memcpy(buf, image.raster[strip * image.resolution[X]], TIFFStripSize(tif));
+		memcpy(buf, buffers->raster[strip * image.resolution[X]], TIFFStripSize(tif));
 		TIFFWriteScanline(tif, buf, strip, 0);
 	}
 
 	_TIFFfree(buf);
 }
 
-void save_tiff(TIFF *tif)
+void save_tiff(TIFF *tif, const struct Image *buffers)
 {
 	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
 
@@ -93,9 +181,9 @@ void save_tiff(TIFF *tif)
 	size_t i;
 	for (i = 0; i < image.pixels; i++) {
 		uint8_t *pixel = pixels[i];
-		pixel[0] = (uint8_t)fmaxf(fminf(image.raster[i][0] * 255.f, 255.f), 0.f);
-		pixel[1] = (uint8_t)fmaxf(fminf(image.raster[i][1] * 255.f, 255.f), 0.f);
-		pixel[2] = (uint8_t)fmaxf(fminf(image.raster[i][2] * 255.f, 255.f), 0.f);
+		pixel[0] = (uint8_t)fmaxf(fminf(buffers->raster[i][0] * 255.f, 255.f), 0.f);
+		pixel[1] = (uint8_t)fmaxf(fminf(buffers->raster[i][1] * 255.f, 255.f), 0.f);
+		pixel[2] = (uint8_t)fmaxf(fminf(buffers->raster[i][2] * 255.f, 255.f), 0.f);
 	}
 
 	tdata_t buf;
@@ -111,12 +199,20 @@ void save_tiff(TIFF *tif)
 	free(pixels);
 }
 
-void save_image(void)
+void save_image(const char *filename)
 {
-	printf_log("Saving image.");
+	save_frame_wait();
+	save_image_buffers(&image, filename);
+}
+
+void save_image_buffers(struct Image *buffers, const char *filename)
+{
+	printf_log("Saving image [%s].", filename);
+
+	if (buffers->cost_buffer)
+		heatmap_to_raster(buffers);
 
 	TIFF *tif;
-	const char *filename = myargv[ARG_OUTPUT_FILENAME];
 	if (unlikely(!strstr(filename, ".tif")))
 		printf_log("Expected output file [%s] with extension .tif.", filename);
 	tif = TIFFOpen(filename, "w");
@@ -130,10 +226,52 @@ void save_image(void)
 	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
 	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1);
 
+	if (buffers->normal_buffer)
+		save_tiff_aov(tif, buffers);
+
 	if (argv_check("-f"))
-		save_tiff_raw(tif);
+		save_tiff_raw(tif, buffers);
 	else
-		save_tiff(tif);
+		save_tiff(tif, buffers);
 
 	TIFFClose(tif);
 }
+
+void *save_frame_thread(void *arg)
+{
+	(void)arg;
+	save_image_buffers(&saved_frame, saved_frame_filename);
+	return NULL;
+}
+
+void save_frame(const char *filename, const bool rendered)
+{
+	save_frame_wait();
+
+	if (!saved_frame.raster)
+		image_buffers_init(&saved_frame, image.normal_buffer, image.cost_buffer);
+	if (rendered) { //Swaps buffers so that the next frame can be rendered into image
+		struct Image frame = image;
+		image.raster = saved_frame.raster;
+		image.z_buffer = saved_frame.z_buffer;
+		image.normal_buffer = saved_frame.normal_buffer;
+		image.albedo_buffer = saved_frame.albedo_buffer;
+		image.material_buffer = saved_frame.material_buffer;
+		image.object_buffer = saved_frame.object_buffer;
+		image.ray_count_buffer = saved_frame.ray_count_buffer;
+		image.cost_buffer = saved_frame.cost_buffer;
+		saved_frame = frame;
+	}
+
+	snprintf(saved_frame_filename, sizeof(saved_frame_filename), "%s", filename);
+	error_check(!pthread_create(&save_frame_thread_id, NULL, save_frame_thread, NULL), "Failed to create thread to save image [%s].", filename);
+	is_saving_frame = true;
+}
+
+void save_frame_wait(void)
+{
+	if (!is_saving_frame)
+		return;
+	pthread_join(save_frame_thread_id, NULL);
+	is_saving_frame = false;
+}
@@ -23,12 +23,27 @@ struct Image {
 
 	v3 *raster;
 	float *z_buffer;
+
+	/* Auxiliary buffers of first-hit data. NULL unless enabled with --aov */
+	v3 *normal_buffer;
+	v3 *albedo_buffer;
+	int32_t *material_buffer; //-1 if nothing was hit
+	int32_t *object_buffer; //-1 if nothing was hit
+	uint32_t *ray_count_buffer;
+
+	uint32_t *cost_buffer; //Bounding cuboids and primitives tested per pixel. NULL unless enabled with --heatmap
 };
 
 void image_init(void);
 void image_deinit(void);
-
-void save_image(void);
+/* Recomputes image plane after camera moved */
+void image_update_camera(void);
+
+void save_image(const char *filename);
+/* Saves frame on another thread while the next frame is rendered into image. If not rendered, the previous frame is saved again */
+void save_frame(const char *filename, bool rendered);
+/* Waits until the frame passed to save_frame is saved */
+void save_frame_wait(void);
 
 extern struct Image image;
 
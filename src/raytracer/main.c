@@ -12,6 +12,7 @@
 #include <stdio.h>
 
 #include "accel.h"
+#include "animation.h"
 #include "argv.h"
 #include "image.h"
 #include "material.h"
@@ -19,6 +20,7 @@
 #include "render.h"
 #include "scene.h"
 #include "system.h"
+#include "trace.h"
 
 static const char *HELPTEXT =
 	"Render a scene using raytracing.\n"
@@ -30,12 +32,15 @@ static const char *HELPTEXT =
 #endif
 #ifdef UNBOUND_OBJECTS
 	"Planes "
+#endif
+#ifdef STATISTICS
+	"Statistics "
 #endif
 	"\n"
 	"Usage: ./engine <input> <output> <resolution> [OPTIONAL_PARAMETERS]\n"
 	"\n"
 	"REQUIRED PARAMETERS:\n"
-	"<input>      (string)            : .json scene file which will be used to generate the image. Example files can be found in ./scenes.\n"
+	"<input>      (string)            : .json or binary scene file which will be used to generate the image. Example files can be found in ./scenes.\n"
 	"<output>     (string)            : .tif file to which the image will be saved.\n"
 	"<resolution> (integer) (integer) : resolution of the output image.\n"
 	"OPTIONAL PARAMETERS:\n"
@@ -50,7 +55,27 @@ static const char *HELPTEXT =
 	"[-g] (string)                    : DEFAULT = ambient : global illumination model.\n"
 	"    ambient    : ambient lighting\n"
 	"    path       : path-tracing\n"
-	"[-f]                             : DEFAULT = OFF     : save raw output for post-processing.\n";
+	"[-f]                             : DEFAULT = OFF     : save raw output for post-processing.\n"
+	"[--aov]                          : DEFAULT = OFF     : save first-hit normal, albedo, material id, object index, and ray count buffers.\n"
+	"[--heatmap]                      : DEFAULT = OFF     : save false-color image of bounding cuboids and primitives tested per pixel.\n";
+
+//Split from HELPTEXT, which would exceed the length of string literals which compilers must support
+static const char *HELPTEXT_CONTINUED =
+	"[--frames] (integer)             : DEFAULT = 1       : number of frames of keyframed animation to render. Frame number is appended to <output>, and frames are saved while the next one renders.\n"
+	"[--deterministic]                : DEFAULT = OFF     : seed random numbers by pixel so that output is reproducible regardless of thread count.\n"
+	"[--shutter] (float)              : DEFAULT = 0.0     : fraction of a frame during which the shutter is open, blurring animated objects. Each of the -n samples per pixel is cast at a different time.\n"
+	"[--rebuild-threshold] (float)    : DEFAULT = 2.0     : when objects move, rebuild parts of BVH whose bounding cuboids grew this many times more than the whole BVH's (or with -DQUANTIZED_BVH, whole BVH once its SAH cost grew this many times).\n"
+	"[--packet] (integer)             : DEFAULT = 16      : number of primary rays through adjacent pixels of a row which are traced through BVH together, from 1 to 16. Rays are traced one at a time with --heatmap, motion blur, depth of field, --filter, or -DQUANTIZED_BVH.\n"
+	"[--sort-rays]                    : DEFAULT = OFF     : with -g path, cast the diffuse bounces of each row after sorting them by direction octant and origin, so that consecutive rays traverse the same parts of BVH.\n"
+	"[--filter] (string)              : DEFAULT = OFF     : cast each of the -n primary rays through a different point in the pixel, and reconstruct image with filter. Rays are cast through pixel centers if omitted.\n"
+	"    box             : box of width 1 pixel\n"
+	"    tent            : tent of width 2 pixels\n"
+	"    mitchell        : Mitchell-Netravali (B = C = 1/3) of width 4 pixels\n"
+	"    blackman-harris : Blackman-Harris of width 3 pixels\n"
+	"[--adaptive] (float)             : DEFAULT = OFF     : with --filter and -g ambient, cast the remaining primary rays only through pixels in which the first 4 differ by more than this in any color channel. Ignored with motion blur.\n"
+	"[--sbvh] (float)                 : DEFAULT = OFF     : build BVH with binned SAH and spatial splits, allowing up to this many references per object.\n"
+	"[--save-scene] (string)          : DEFAULT = OFF     : save unscaled scene, including triangles of meshes, as binary scene file which loads faster than .json.\n"
+	"[--trace] (string)               : DEFAULT = OFF     : save timeline of loading, BVH generation, rendering of each row, and saving as Chrome trace JSON.\n";
 
 int main(int argc, char *argv[]);
 
@@ -61,7 +86,8 @@ int main(int argc, char *argv[])
 	argv_init();
 
 	if (argv_check("--help") || argv_check("-h")) {
-		puts(HELPTEXT);
+		fputs(HELPTEXT, stdout);
+		puts(HELPTEXT_CONTINUED);
 		return 0;
 	} else if (argc < 5) {
 		puts("Too few arguments. Use --help to find out which arguments are required to call this program.");
@@ -69,19 +95,57 @@ int main(int argc, char *argv[])
 	}
 
 	system_init();
+	trace_init();
 
+	double t = trace_time();
 	scene_load();
+	trace_event("Scene load", myargv[ARG_INPUT_FILENAME], t);
 	image_init();
 
+	t = trace_time();
 	accel_init();
+	trace_event("BVH build", NULL, t);
 	render_init();
 
-	render();
+	uint32_t frame;
+	for (frame = 0; frame < num_frames; frame++) {
+		bool changed = !frame;
+		if (frame) {
+			printf_log("Updating frame %u.", frame);
+			t = trace_time();
+			if (animation_update(frame)) {
+				accel_update();
+				changed = true;
+			}
+			if (animation_update_camera(frame)) {
+				image_update_camera();
+				changed = true;
+			}
+			trace_event("Frame update", NULL, t);
+		}
 
-	save_image();
+		if (changed)
+			render();
+		else
+			printf_log("Reusing unchanged frame.");
+
+		char filename[FILENAME_MAX];
+		animation_get_filename(frame, filename, sizeof(filename));
+		t = trace_time();
+		if (num_frames == 1)
+			save_image(filename);
+		else
+			save_frame(filename, changed);
+		trace_event("Image save", filename, t); //Time spent waiting for previous frame to be saved when saving asynchronously
+	}
+	t = trace_time();
+	save_frame_wait();
+	trace_event("Image save", NULL, t);
 
 	printf_log("Terminating.");
+	trace_deinit();
 	accel_deinit();
+	animation_deinit();
 	argv_deinit();
 	image_deinit();
 	materials_deinit();
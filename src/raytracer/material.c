@@ -19,11 +19,16 @@
 #include "calc.h"
 #include "error.h"
 #include "mem.h"
+#include "strhash.h"
 
 #include "SimplexNoise.h"
 
 #define MATERIAL_THRESHOLD 1e-6f
 
+/* Bytes of struct Material, from ks to texture, compared when interning materials */
+#define MATERIAL_CONTENT_OFFSET offsetof(struct Material, ks)
+#define MATERIAL_CONTENT_SIZE (offsetof(struct Material, reflective) - MATERIAL_CONTENT_OFFSET)
+
 struct TextureUniform {
 	struct Texture texture;
 	v3 color;
@@ -52,6 +57,17 @@ struct TextureNoisyPeriodic {
 	enum PeriodicFunction func;
 };
 
+struct MaterialIdEntry {
+	int32_t id;
+	struct Material *material; //NULL if entry is empty
+};
+
+struct TextureEntry {
+	struct TextureParameters parameters;
+	struct Texture *texture; //NULL if entry is empty
+};
+
+bool material_equal(const struct Material *a, const struct Material *b);
 void texture_get_color_uniform(const struct Texture *tex, const v3 point, v3 color);
 void texture_get_color_checkerboard(const struct Texture *tex, const v3 point, v3 color);
 void texture_get_color_brick(const struct Texture *tex, const v3 point, v3 color);
@@ -60,11 +76,30 @@ void texture_get_color_noisy_periodic(const struct Texture *tex, const v3 point,
 struct Material *materials;
 size_t num_materials;
 
-void materials_init(void)
+static struct Arena texture_arena;
+
+/* Open addressing hash tables with linear probing, which are at most half full */
+static size_t max_materials;
+static size_t material_table_mask;
+static struct MaterialIdEntry *material_id_table;
+static struct Material **material_table; //Interned materials
+static struct TextureEntry *texture_table; //Interned textures
+
+void materials_init(const size_t max_num_materials)
 {
 	printf_log("Initializing materials.");
 
-	materials = safe_malloc(sizeof(struct Material) * num_materials);
+	max_materials = max_num_materials;
+	num_materials = 0;
+	materials = safe_malloc(sizeof(struct Material) * max_materials);
+
+	size_t table_size = 1;
+	while (table_size < 2 * max_materials)
+		table_size <<= 1;
+	material_table_mask = table_size - 1;
+	material_id_table = safe_calloc(table_size, sizeof(struct MaterialIdEntry));
+	material_table = safe_calloc(table_size, sizeof(struct Material *));
+	texture_table = safe_calloc(table_size, sizeof(struct TextureEntry));
 }
 
 void material_init(struct Material *material, const int32_t id, const v3 ks, const v3 ka, const v3 kr, const v3 kt, const v3 ke, const float shininess, const float refractive_index, struct Texture *const texture)
@@ -83,27 +118,61 @@ void material_init(struct Material *material, const int32_t id, const v3 ks, con
 	material->transparent = mag3(kt) > MATERIAL_THRESHOLD;
 }
 
+struct Material *material_new(const int32_t id, const v3 ks, const v3 ka, const v3 kr, const v3 kt, const v3 ke, const float shininess, const float refractive_index, struct Texture *const texture)
+{
+	struct Material material;
+	material_init(&material, id, ks, ka, kr, kt, ke, shininess, refractive_index, texture);
+
+	size_t i = hash_djb_bytes((const uint8_t *)&material + MATERIAL_CONTENT_OFFSET, MATERIAL_CONTENT_SIZE) & material_table_mask;
+	while (material_table[i] && !material_equal(material_table[i], &material))
+		i = (i + 1) & material_table_mask;
+	if (!material_table[i]) {
+		error_check(num_materials < max_materials, "Exceeded maximum number of materials [%zu].", max_materials);
+		material_table[i] = &materials[num_materials++];
+		*material_table[i] = material;
+	}
+	struct Material *interned = material_table[i];
+
+	i = hash_djb_bytes(&id, sizeof(int32_t)) & material_table_mask;
+	while (material_id_table[i].material && material_id_table[i].id != id)
+		i = (i + 1) & material_table_mask;
+	if (!material_id_table[i].material) { //If ids are duplicated, the first material is used
+		material_id_table[i].id = id;
+		material_id_table[i].material = interned;
+	}
+
+	return interned;
+}
+
+bool material_equal(const struct Material *a, const struct Material *b)
+{
+	return !memcmp((const uint8_t *)a + MATERIAL_CONTENT_OFFSET, (const uint8_t *)b + MATERIAL_CONTENT_OFFSET, MATERIAL_CONTENT_SIZE);
+}
+
 void materials_deinit(void)
 {
-	size_t i;
-	for (i = 0; i < num_materials; i++)
-		free(materials[i].texture);
+	arena_deinit(&texture_arena);
 	free(materials);
+	free(material_id_table);
+	free(material_table);
+	free(texture_table);
 }
 
 struct Material *get_material(const int32_t id)
 {
-	size_t i;
-	for (i = 0; i < num_materials; i++)
-		if (materials[i].id == id)
-			return &materials[i];
+	size_t i = hash_djb_bytes(&id, sizeof(int32_t)) & material_table_mask;
+	while (material_id_table[i].material) {
+		if (material_id_table[i].id == id)
+			return material_id_table[i].material;
+		i = (i + 1) & material_table_mask;
+	}
 	error("Failed to get material id [%d].", id);
 	return NULL;
 }
 
 struct Texture *texture_uniform_new(const v3 color)
 {
-	struct TextureUniform *texture = safe_malloc(sizeof(struct TextureUniform));
+	struct TextureUniform *texture = arena_alloc(&texture_arena, sizeof(struct TextureUniform));
 
 	texture->texture.get_color = &texture_get_color_uniform;
 	assign3(texture->color, color);
@@ -113,7 +182,7 @@ struct Texture *texture_uniform_new(const v3 color)
 
 struct Texture *texture_checkerboard_new(v3 colors[2], const float scale)
 {
-	struct TextureCheckerboard *texture = safe_malloc(sizeof(struct TextureCheckerboard));
+	struct TextureCheckerboard *texture = arena_alloc(&texture_arena, sizeof(struct TextureCheckerboard));
 
 	texture->texture.get_color = &texture_get_color_checkerboard;
 	texture->scale = scale;
@@ -124,7 +193,7 @@ struct Texture *texture_checkerboard_new(v3 colors[2], const float scale)
 
 struct Texture *texture_brick_new(v3 colors[2], const float scale, const float mortar_width)
 {
-	struct TextureBrick *texture = safe_malloc(sizeof(struct TextureBrick));
+	struct TextureBrick *texture = arena_alloc(&texture_arena, sizeof(struct TextureBrick));
 
 	texture->texture.get_color = &texture_get_color_brick;
 	texture->scale = scale;
@@ -136,7 +205,7 @@ struct Texture *texture_brick_new(v3 colors[2], const float scale, const float m
 
 struct Texture *texture_noisy_periodic_new(const v3 color, const v3 color_gradient, const float noise_feature_scale, const float noise_scale, const float frequency_scale, const enum PeriodicFunction func)
 {
-	struct TextureNoisyPeriodic *texture = safe_malloc(sizeof(struct TextureNoisyPeriodic));
+	struct TextureNoisyPeriodic *texture = arena_alloc(&texture_arena, sizeof(struct TextureNoisyPeriodic));
 
 	texture->texture.get_color = &texture_get_color_noisy_periodic;
 	texture->noise_feature_scale = noise_feature_scale;
@@ -149,6 +218,68 @@ struct Texture *texture_noisy_periodic_new(const v3 color, const v3 color_gradie
 	return (struct Texture *)texture;
 }
 
+struct Texture *texture_new(const struct TextureParameters *parameters)
+{
+	size_t i = hash_djb_bytes(parameters, sizeof(struct TextureParameters)) & material_table_mask;
+	while (texture_table[i].texture && memcmp(&texture_table[i].parameters, parameters, sizeof(struct TextureParameters)))
+		i = (i + 1) & material_table_mask;
+	if (texture_table[i].texture)
+		return texture_table[i].texture;
+
+	struct Texture *texture;
+	switch ((enum TextureType)parameters->type) {
+	case TEXTURE_UNIFORM:
+		texture = texture_uniform_new(parameters->colors[0]);
+		break;
+	case TEXTURE_CHECKERBOARD:
+		texture = texture_checkerboard_new((v3 *)parameters->colors, parameters->scale);
+		break;
+	case TEXTURE_BRICK:
+		texture = texture_brick_new((v3 *)parameters->colors, parameters->scale, parameters->mortar_width);
+		break;
+	case TEXTURE_NOISY_PERIODIC:
+		error_check(parameters->func <= PERIODIC_FUNC_SQUARE, "Invalid periodic function [%u].", parameters->func);
+		texture = texture_noisy_periodic_new(parameters->colors[0], parameters->colors[1], parameters->noise_feature_scale, parameters->noise_scale, parameters->frequency_scale, parameters->func);
+		break;
+	default:
+		error("Invalid texture type [%u].", parameters->type);
+	}
+
+	texture_table[i].parameters = *parameters;
+	texture_table[i].texture = texture;
+	return texture;
+}
+
+void texture_get_parameters(const struct Texture *texture, struct TextureParameters *parameters)
+{
+	memset(parameters, 0, sizeof(struct TextureParameters));
+	if (texture->get_color == &texture_get_color_uniform) {
+		const struct TextureUniform *uniform = (const struct TextureUniform *)texture;
+		parameters->type = TEXTURE_UNIFORM;
+		assign3(parameters->colors[0], uniform->color);
+	} else if (texture->get_color == &texture_get_color_checkerboard) {
+		const struct TextureCheckerboard *checkerboard = (const struct TextureCheckerboard *)texture;
+		parameters->type = TEXTURE_CHECKERBOARD;
+		memcpy(parameters->colors, checkerboard->colors, sizeof(v3[2]));
+		parameters->scale = checkerboard->scale;
+	} else if (texture->get_color == &texture_get_color_brick) {
+		const struct TextureBrick *brick = (const struct TextureBrick *)texture;
+		parameters->type = TEXTURE_BRICK;
+		memcpy(parameters->colors, brick->colors, sizeof(v3[2]));
+		parameters->scale = brick->scale;
+		parameters->mortar_width = brick->mortar_width;
+	} else {
+		const struct TextureNoisyPeriodic *noisy_periodic = (const struct TextureNoisyPeriodic *)texture;
+		parameters->type = TEXTURE_NOISY_PERIODIC;
+		parameters->func = noisy_periodic->func;
+		assign3(parameters->colors[0], noisy_periodic->color);
+		assign3(parameters->colors[1], noisy_periodic->color_gradient);
+		parameters->noise_feature_scale = noisy_periodic->noise_feature_scale;
+		parameters->noise_scale = noisy_periodic->noise_scale;
+		parameters->frequency_scale = noisy_periodic->frequency_scale;
+	}
+}
+
 void texture_get_color_uniform(const struct Texture *tex, const v3 point, v3 color)
 {
 	(void)point;
@@ -22,6 +22,24 @@ enum PeriodicFunction {
 	PERIODIC_FUNC_SQUARE,
 };
 
+enum TextureType {
+	TEXTURE_UNIFORM,
+	TEXTURE_CHECKERBOARD,
+	TEXTURE_BRICK,
+	TEXTURE_NOISY_PERIODIC,
+};
+
+struct TextureParameters { //Parameters of any texture, as stored in binary scenes. Unused members must be zero
+	uint32_t type;
+	uint32_t func;
+	v3 colors[2]; //color and color gradient of noisy periodic textures
+	float scale;
+	float mortar_width;
+	float noise_feature_scale;
+	float noise_scale;
+	float frequency_scale;
+};
+
 struct Texture;
 
 struct Texture {
@@ -37,22 +55,27 @@ struct Material {
 	v3 ke; /*emittance constant*/
 	float shininess; /*shininess constant*/
 	float refractive_index;
-	struct Texture *texture;
+	struct Texture *texture; /*members from ks to texture are compared when interning*/
 	bool reflective;
 	bool transparent;
 	bool emittant;
 };
 
-/* requires num_materials to be set. */
-void materials_init(void);
+/* Allocates space for max_num_materials distinct materials */
+void materials_init(size_t max_num_materials);
 void materials_deinit(void);
 
+/* Returns existing material if one with identical parameters exists */
+struct Material *material_new(int32_t id, const v3 ks, const v3 ka, const v3 kr, const v3 kt, const v3 ke, float shininess, float refractive_index, struct Texture *const texture);
 void material_init(struct Material *material, int32_t id, const v3 ks, const v3 ka, const v3 kr, const v3 kt, const v3 ke, float shininess, float refractive_index, struct Texture *const texture);
 
 struct Texture *texture_uniform_new(const v3 color);
 struct Texture *texture_checkerboard_new(v3 colors[2], float scale);
 struct Texture *texture_brick_new(v3 colors[2], float scale, float mortar_width);
 struct Texture *texture_noisy_periodic_new(const v3 color, const v3 color_gradient, float noise_feature_scale, float noise_scale, float frequency_scale, enum PeriodicFunction func);
+/* Returns existing texture if one with identical parameters exists. Requires materials_init to be called before */
+struct Texture *texture_new(const struct TextureParameters *parameters);
+void texture_get_parameters(const struct Texture *texture, struct TextureParameters *parameters);
 
 struct Material *get_material(int32_t id);
 
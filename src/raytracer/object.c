@@ -9,17 +9,25 @@
  *   Objects
  **/
 
+#define _POSIX_C_SOURCE 200809L /* mmap */
+
 #include "object.h"
 
+#include <fcntl.h>
 #include <float.h>
 #include <math.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "calc.h"
 #include "error.h"
 #include "material.h"
 #include "mem.h"
+#include "stats.h"
 #include "system.h"
+#include "trace.h"
 
 struct Sphere {
 	struct Object object;
@@ -34,52 +42,176 @@ struct Triangle { //triangle ABC
 	v3 normal;
 };
 
+struct Quad { //Parallelogram spanned by edges from corner at position
+	struct Object object;
+	v3 position;
+	v3 edges[2];
+	v3 normal;
+	v3 w; //Cross product of edges divided by its squared magnitude, used to find barycentric coordinates
+};
+
+struct Disc {
+	struct Object object;
+	v3 position;
+	v3 normal;
+	float radius;
+	v3 tangents[2]; //Perpendicular to normal and each other
+};
+
+struct Cylinder { //Capped cylinder from base at position, along axis
+	struct Object object;
+	v3 position;
+	v3 axis; //Normalized
+	float height;
+	float radius;
+	v3 tangents[2]; //Perpendicular to axis and each other
+};
+
+struct Box { //Oriented cuboid
+	struct Object object;
+	v3 position; //Center
+	v3 half_size;
+	m3 axes; //Rows are the box's X, Y, and Z axes, so that multiplying by axes transforms a vector into the box's space
+};
+
 #ifdef UNBOUND_OBJECTS
 struct Plane { //normal = {a,b,c}, ax + by + cz = d
 	struct Object object;
 	v3 normal;
 	float d;
+	bool crosses_corners; //Plane passes through plane_corners, so rays which remain within them may intersect it
 };
+
+static v3 plane_corners[2]; //Cuboid around the bounded objects and camera, which most rays do not leave
 #endif
 
+#define STL_HEADER_SIZE 84 /* 80 byte header followed by triangle count */
+
 struct STLTriangle {
 	float normal[3]; //normal is unreliable so it is not used.
 	float vertices[3][3];
 	uint16_t attribute_bytes; //attribute bytes is unreliable so it is not used.
 } __attribute__((packed));
 
+#define PLY_MAX_ELEMENTS 16
+#define PLY_MAX_PROPERTIES 32
+
+enum PLYType {
+	PLY_INT8,
+	PLY_UINT8,
+	PLY_INT16,
+	PLY_UINT16,
+	PLY_INT32,
+	PLY_UINT32,
+	PLY_FLOAT32,
+	PLY_FLOAT64,
+};
+
+struct PLYProperty {
+	char name[32];
+	bool is_list;
+	enum PLYType count_type; //Only used by lists
+	enum PLYType type;
+};
+
+struct PLYElement {
+	char name[32];
+	size_t count;
+	size_t num_properties;
+	struct PLYProperty properties[PLY_MAX_PROPERTIES];
+};
+
 /* Sphere */
 void sphere_postinit(struct Object *object);
-void sphere_delete(struct Object *object);
 bool sphere_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal);
 bool sphere_intersects_in_range(const struct Object *object, const struct Ray *ray, const float min_distance);
 void sphere_get_corners(const struct Object *object, v3 corners[2]);
 void sphere_scale(const struct Object *object, const v3 neg_shift, const float scale);
 void sphere_get_light_point(const struct Object *object, const v3 point, v3 light_point);
-bool line_intersects_sphere(const v3 sphere_position, const float sphere_radius, const v3 line_position, const v3 line_vector, const float epsilon, float *distance);
+void sphere_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS]);
+void sphere_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation);
 
 /* Triangle */
 void triangle_postinit(struct Object *object);
-void triangle_delete(struct Object *object);
 bool triangle_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal);
 bool triangle_intersects_in_range(const struct Object *object, const struct Ray *ray, float min_distance);
 void triangle_get_corners(const struct Object *object, v3 corners[2]);
 void triangle_scale(const struct Object *object, const v3 neg_shift, const float scale);
 void triangle_get_light_point(const struct Object *object, const v3 point, v3 light_point);
-bool moller_trumbore(const v3 vertex, v3 edges[2], const v3 line_position, const v3 line_vector, const float epsilon, float *distance);
+void triangle_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS]);
+void triangle_get_clipped_corners(const struct Object *object, v3 bounds[2], v3 corners[2]);
+void triangle_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation);
+
+/* Quad */
+void quad_postinit(struct Object *object);
+bool quad_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal);
+bool quad_intersects_in_range(const struct Object *object, const struct Ray *ray, float min_distance);
+void quad_get_corners(const struct Object *object, v3 corners[2]);
+void quad_scale(const struct Object *object, const v3 neg_shift, const float scale);
+void quad_get_light_point(const struct Object *object, const v3 point, v3 light_point);
+void quad_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS]);
+void quad_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation);
+
+/* Disc */
+void disc_postinit(struct Object *object);
+bool disc_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal);
+bool disc_intersects_in_range(const struct Object *object, const struct Ray *ray, float min_distance);
+void disc_get_corners(const struct Object *object, v3 corners[2]);
+void disc_scale(const struct Object *object, const v3 neg_shift, const float scale);
+void disc_get_light_point(const struct Object *object, const v3 point, v3 light_point);
+void disc_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS]);
+void disc_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation);
+
+/* Cylinder */
+void cylinder_postinit(struct Object *object);
+bool cylinder_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal);
+bool cylinder_intersects_in_range(const struct Object *object, const struct Ray *ray, float min_distance);
+void cylinder_get_corners(const struct Object *object, v3 corners[2]);
+void cylinder_scale(const struct Object *object, const v3 neg_shift, const float scale);
+void cylinder_get_light_point(const struct Object *object, const v3 point, v3 light_point);
+void cylinder_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS]);
+void cylinder_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation);
+
+/* Box */
+void box_postinit(struct Object *object);
+bool box_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal);
+bool box_intersects_in_range(const struct Object *object, const struct Ray *ray, float min_distance);
+void box_get_corners(const struct Object *object, v3 corners[2]);
+void box_scale(const struct Object *object, const v3 neg_shift, const float scale);
+void box_get_light_point(const struct Object *object, const v3 point, v3 light_point);
+void box_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS]);
+void box_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation);
+
+/* Shared by bounded objects */
+void bounded_get_clipped_corners(const struct Object *object, v3 bounds[2], v3 corners[2]);
+void get_tangents(const v3 normal, v3 tangents[2]);
+bool line_intersects_disc(const v3 disc_position, const v3 disc_normal, float disc_radius, const v3 line_position, const v3 line_vector, float epsilon, float *distance);
 
 /* Plane */
 #ifdef UNBOUND_OBJECTS
 void plane_postinit(struct Object *object);
-void plane_delete(struct Object *object);
-bool plane_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal);
 bool plane_intersects_in_range(const struct Object *object, const struct Ray *ray, float min_distance);
 void plane_scale(const struct Object *object, const v3 neg_shift, const float scale);
+void plane_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS]);
+void plane_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation);
+void plane_update_crosses_corners(struct Plane *plane);
+bool plane_corners_contain(const v3 point);
 #endif
 
+/* Motion */
+void motion_rotate(const struct Motion *motion, float sin_angle, float cos_angle, const v3 vec, v3 result);
+void motion_transform_ray(const struct Motion *motion, const struct Ray *ray, struct Ray *moved_ray, float *sin_angle, float *cos_angle);
+
 /* Mesh */
-void stl_load_objects(FILE *file, const char *filename, struct Object *object, const v3 position, const v3 rot, const float scale, size_t *i_object);
-uint32_t stl_get_num_triangles(FILE *file);
+struct Triangle *mesh_triangles_new(size_t num_triangles);
+void mesh_indexed_to_objects(v3 *vertices, size_t num_vertices, const uint32_t (*faces)[3], size_t num_faces, const char *filename, const struct Object *object, m3 transform, const v3 position, size_t *i_object);
+bool mesh_parse_number(const char **cp, const char *end, double *number);
+void *mesh_append(void *buffer, size_t *capacity, size_t count, size_t size);
+void stl_load_objects(const uint8_t *data, size_t size, const char *filename, const struct Object *object, m3 transform, const v3 position, size_t *i_object);
+void obj_load_objects(const char *data, size_t size, const char *filename, const struct Object *object, m3 transform, const v3 position, size_t *i_object);
+double ply_read(const uint8_t **data, const uint8_t *end, enum PLYType type, bool big_endian, const char *filename);
+enum PLYType ply_parse_type(const char *name, const char *filename);
+void ply_load_objects(const uint8_t *data, size_t size, const char *filename, const struct Object *object, m3 transform, const v3 position, size_t *i_object);
 
 static const struct ObjectVTable OBJECT_DATA[] = {
 #ifdef UNBOUND_OBJECTS
@@ -89,8 +221,9 @@ static const struct ObjectVTable OBJECT_DATA[] = {
 		.postinit = &plane_postinit,
 		.get_intersection = &plane_get_intersection,
 		.intersects_in_range = &plane_intersects_in_range,
-		.delete = &plane_delete,
 		.scale = &plane_scale,
+		.get_parameters = &plane_get_parameters,
+		.transform = &plane_transform,
 	},
 #endif
 	[OBJECT_SPHERE] = {
@@ -101,10 +234,12 @@ static const struct ObjectVTable OBJECT_DATA[] = {
 		.postinit = &sphere_postinit,
 		.get_intersection = &sphere_get_intersection,
 		.intersects_in_range = &sphere_intersects_in_range,
-		.delete = &sphere_delete,
 		.get_corners = &sphere_get_corners,
 		.scale = &sphere_scale,
 		.get_light_point = &sphere_get_light_point,
+		.get_parameters = &sphere_get_parameters,
+		.get_clipped_corners = &bounded_get_clipped_corners,
+		.transform = &sphere_transform,
 	},
 	[OBJECT_TRIANGLE] = {
 		.type = OBJECT_TRIANGLE,
@@ -114,10 +249,72 @@ static const struct ObjectVTable OBJECT_DATA[] = {
 		.postinit = &triangle_postinit,
 		.get_intersection = &triangle_get_intersection,
 		.intersects_in_range = &triangle_intersects_in_range,
-		.delete = &triangle_delete,
 		.get_corners = &triangle_get_corners,
 		.scale = &triangle_scale,
 		.get_light_point = &triangle_get_light_point,
+		.get_parameters = &triangle_get_parameters,
+		.get_clipped_corners = &triangle_get_clipped_corners,
+		.transform = &triangle_transform,
+	},
+	[OBJECT_QUAD] = {
+		.type = OBJECT_QUAD,
+#ifdef UNBOUND_OBJECTS
+		.is_bounded = true,
+#endif
+		.postinit = &quad_postinit,
+		.get_intersection = &quad_get_intersection,
+		.intersects_in_range = &quad_intersects_in_range,
+		.get_corners = &quad_get_corners,
+		.scale = &quad_scale,
+		.get_light_point = &quad_get_light_point,
+		.get_parameters = &quad_get_parameters,
+		.get_clipped_corners = &bounded_get_clipped_corners,
+		.transform = &quad_transform,
+	},
+	[OBJECT_DISC] = {
+		.type = OBJECT_DISC,
+#ifdef UNBOUND_OBJECTS
+		.is_bounded = true,
+#endif
+		.postinit = &disc_postinit,
+		.get_intersection = &disc_get_intersection,
+		.intersects_in_range = &disc_intersects_in_range,
+		.get_corners = &disc_get_corners,
+		.scale = &disc_scale,
+		.get_light_point = &disc_get_light_point,
+		.get_parameters = &disc_get_parameters,
+		.get_clipped_corners = &bounded_get_clipped_corners,
+		.transform = &disc_transform,
+	},
+	[OBJECT_CYLINDER] = {
+		.type = OBJECT_CYLINDER,
+#ifdef UNBOUND_OBJECTS
+		.is_bounded = true,
+#endif
+		.postinit = &cylinder_postinit,
+		.get_intersection = &cylinder_get_intersection,
+		.intersects_in_range = &cylinder_intersects_in_range,
+		.get_corners = &cylinder_get_corners,
+		.scale = &cylinder_scale,
+		.get_light_point = &cylinder_get_light_point,
+		.get_parameters = &cylinder_get_parameters,
+		.get_clipped_corners = &bounded_get_clipped_corners,
+		.transform = &cylinder_transform,
+	},
+	[OBJECT_BOX] = {
+		.type = OBJECT_BOX,
+#ifdef UNBOUND_OBJECTS
+		.is_bounded = true,
+#endif
+		.postinit = &box_postinit,
+		.get_intersection = &box_get_intersection,
+		.intersects_in_range = &box_intersects_in_range,
+		.get_corners = &box_get_corners,
+		.scale = &box_scale,
+		.get_light_point = &box_get_light_point,
+		.get_parameters = &box_get_parameters,
+		.get_clipped_corners = &bounded_get_clipped_corners,
+		.transform = &box_transform,
 	},
 };
 
@@ -130,6 +327,8 @@ struct Object **unbound_objects;
 size_t num_unbound_objects;
 #endif
 
+static struct Arena object_arena; //Storage of all objects
+
 void objects_init(void)
 {
 	printf_log("Initializing objects.");
@@ -144,11 +343,7 @@ void objects_init(void)
 
 void objects_deinit(void)
 {
-	size_t i;
-	for (i = 0; i < num_objects; i++)
-		// clang-format off
-		objects[i]->object_data->delete(objects[i]);
-	// clang-format on
+	arena_deinit(&object_arena);
 	free(objects);
 #ifdef UNBOUND_OBJECTS
 	free(unbound_objects);
@@ -162,20 +357,90 @@ void object_init(struct Object *object, const struct Material *material, const f
 	object->material = material;
 	object->epsilon = epsilon;
 	object->num_lights = num_lights;
+	object->is_animated = false;
+	object->motion = NULL;
+}
+
+struct Object *object_new(const enum ObjectType object_type, const float parameters[OBJECT_MAX_PARAMETERS])
+{
+	switch (object_type) {
+	case OBJECT_SPHERE:
+		return sphere_new(parameters, parameters[3]);
+	case OBJECT_TRIANGLE:
+		return triangle_new((v3 *)parameters);
+	case OBJECT_QUAD:
+		return quad_new(parameters, (v3 *)&parameters[3]);
+	case OBJECT_DISC:
+		return disc_new(parameters, &parameters[3], parameters[6]);
+	case OBJECT_CYLINDER:
+		return cylinder_new(parameters, &parameters[3], parameters[6]);
+	case OBJECT_BOX:
+		return box_new(parameters, &parameters[3], &parameters[6]);
+#ifdef UNBOUND_OBJECTS
+	case OBJECT_PLANE: { //normal is already normalized, so it is copied to keep the plane bit-identical
+		struct Plane *plane = arena_alloc(&object_arena, sizeof(struct Plane));
+		assign3(plane->normal, parameters);
+		plane->d = parameters[3];
+		plane_update_crosses_corners(plane);
+		return (struct Object *)plane;
+	}
+#endif
+	}
+	UNREACHABLE;
 }
 
 #ifdef UNBOUND_OBJECTS
+//Pads bounding cuboid of bounded objects and viewpoint, so that points on their surfaces are within it
+void unbound_objects_init(const v3 viewpoint)
+{
+	get_objects_extents(plane_corners[0], plane_corners[1]);
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		plane_corners[0][i] = fminf(plane_corners[0][i], viewpoint[i]);
+		plane_corners[1][i] = fmaxf(plane_corners[1][i], viewpoint[i]);
+	}
+	v3 diagonal;
+	sub3v(plane_corners[1], plane_corners[0], diagonal);
+	float padding = mag3(diagonal) * 1e-3f;
+	sub3s(plane_corners[0], padding, plane_corners[0]);
+	add3s(plane_corners[1], padding, plane_corners[1]);
+
+	for (i = 0; i < num_unbound_objects; i++)
+		plane_update_crosses_corners((struct Plane *)unbound_objects[i]);
+}
+
+//Checks if ray remains within plane_corners up to distance, in which case it cannot intersect planes which do not cross them
+bool unbound_objects_contain(const struct Ray *ray, const float distance)
+{
+	v3 end;
+	mul3s(ray->direction, distance, end);
+	add3v(end, ray->point, end);
+	return plane_corners_contain(ray->point) && plane_corners_contain(end);
+}
+
+//Must be called after the BVH was traversed, so that planes beyond the closest object are skipped
 void unbound_objects_get_closest_intersection(const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance)
 {
 	float distance;
 	v3 normal;
+	int is_contained = -1; //Only checked once a plane can be skipped
 	size_t i;
 	for (i = 0; i < num_unbound_objects; i++) {
 		struct Object *object = unbound_objects[i];
-		if (object->object_data->get_intersection(object, ray, &distance, normal) && distance < *closest_distance) {
-			*closest_distance = distance;
-			*closest_object = object;
-			assign3(closest_normal, normal);
+		if (!((struct Plane *)object)->crosses_corners && !object->motion) {
+			if (is_contained < 0)
+				is_contained = unbound_objects_contain(ray, *closest_distance);
+			if (is_contained)
+				continue;
+		}
+		STAT_INC(STAT_PRIMITIVE_TESTS);
+		if (object_get_intersection(object, ray, &distance, normal)) {
+			STAT_INC_HIT(object->object_data->type);
+			if (distance < *closest_distance) {
+				*closest_distance = distance;
+				*closest_object = object;
+				assign3(closest_normal, normal);
+			}
 		}
 	}
 }
@@ -183,10 +448,19 @@ void unbound_objects_get_closest_intersection(const struct Ray *ray, struct Obje
 bool unbound_objects_is_light_blocked(const struct Ray *ray, const float distance, v3 light_intensity, const struct Object *emittant_object)
 {
 	(void)emittant_object; //NOTE: is unused because planes cant be lights
+	int is_contained = -1;
 	size_t i;
 	for (i = 0; i < num_unbound_objects; i++) {
 		struct Object *object = unbound_objects[i];
-		if (object->object_data->intersects_in_range(unbound_objects[i], ray, distance)) {
+		if (!((struct Plane *)object)->crosses_corners && !object->motion) {
+			if (is_contained < 0)
+				is_contained = unbound_objects_contain(ray, distance);
+			if (is_contained)
+				continue;
+		}
+		STAT_INC(STAT_PRIMITIVE_TESTS);
+		if (object_intersects_in_range(object, ray, distance)) {
+			STAT_INC_HIT(object->object_data->type);
 			if (object->material->transparent)
 				mul3v(light_intensity, object->material->kt, light_intensity);
 			else
@@ -211,7 +485,7 @@ void get_objects_extents(v3 min, v3 max)
 		if (object->object_data->is_bounded) {
 #endif
 			v3 corners[2];
-			object->object_data->get_corners(object, corners);
+			object_get_corners(object, corners);
 			for (j = 0; j < 3; j++) {
 				if (corners[0][j] < min[j])
 					min[j] = corners[0][j];
@@ -224,6 +498,129 @@ void get_objects_extents(v3 min, v3 max)
 	}
 }
 
+//Clips bounding cuboid of object, which is tight enough for objects that are not long and thin
+void bounded_get_clipped_corners(const struct Object *object, v3 bounds[2], v3 corners[2])
+{
+	object->object_data->get_corners(object, corners);
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		corners[0][i] = fmaxf(corners[0][i], bounds[0][i]);
+		corners[1][i] = fminf(corners[1][i], bounds[1][i]);
+	}
+}
+
+//Orthonormal vectors perpendicular to normalized normal
+void get_tangents(const v3 normal, v3 tangents[2])
+{
+	v3 helper = { 0.f, 0.f, 0.f };
+	helper[fabsf(normal[X]) < 0.9f ? X : Y] = 1.f;
+	cross(normal, helper, tangents[0]);
+	norm3(tangents[0]);
+	cross(normal, tangents[0], tangents[1]);
+}
+
+/*******************************************************************************
+*	Motion
+*******************************************************************************/
+
+//Rodrigues' rotation about motion->axis
+void motion_rotate(const struct Motion *motion, const float sin_angle, const float cos_angle, const v3 vec, v3 result)
+{
+	v3 axis_cross_vec;
+	cross(motion->axis, vec, axis_cross_vec);
+	float axis_dot_vec = dot3(motion->axis, vec) * (1.f - cos_angle);
+	size_t i;
+	for (i = 0; i < 3; i++)
+		result[i] = vec[i] * cos_angle + axis_cross_vec[i] * sin_angle + motion->axis[i] * axis_dot_vec;
+}
+
+//Moves ray by inverse of motion at ray->time, so that it can be intersected with the object in its pose when the shutter opens
+void motion_transform_ray(const struct Motion *motion, const struct Ray *ray, struct Ray *moved_ray, float *sin_angle, float *cos_angle)
+{
+	const float time = ray->time;
+	*sin_angle = sinf(motion->angle * time);
+	*cos_angle = cosf(motion->angle * time);
+
+	v3 point;
+	mul3s(motion->translation, time, point);
+	add3v(point, motion->center, point);
+	sub3v(ray->point, point, point);
+	motion_rotate(motion, -*sin_angle, *cos_angle, point, moved_ray->point);
+	add3v(moved_ray->point, motion->center, moved_ray->point);
+	motion_rotate(motion, -*sin_angle, *cos_angle, ray->direction, moved_ray->direction);
+	moved_ray->time = time;
+}
+
+bool object_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal)
+{
+	if (likely(!object->motion))
+		return object->object_data->get_intersection(object, ray, distance, normal);
+
+	struct Ray moved_ray;
+	float sin_angle, cos_angle;
+	motion_transform_ray(object->motion, ray, &moved_ray, &sin_angle, &cos_angle);
+	v3 moved_normal;
+	if (!object->object_data->get_intersection(object, &moved_ray, distance, moved_normal))
+		return false;
+	motion_rotate(object->motion, sin_angle, cos_angle, moved_normal, normal);
+	return true;
+}
+
+bool object_intersects_in_range(const struct Object *object, const struct Ray *ray, const float min_distance)
+{
+	if (likely(!object->motion))
+		return object->object_data->intersects_in_range(object, ray, min_distance);
+
+	struct Ray moved_ray;
+	float sin_angle, cos_angle;
+	motion_transform_ray(object->motion, ray, &moved_ray, &sin_angle, &cos_angle);
+	return object->object_data->intersects_in_range(object, &moved_ray, min_distance);
+}
+
+//Bounds corners of the object's bounding cuboid when the shutter opens and closes, grown by the sagitta of the arc they rotate along
+void object_get_corners(const struct Object *object, v3 corners[2])
+{
+	object->object_data->get_corners(object, corners);
+	const struct Motion *motion = object->motion;
+	if (likely(!motion))
+		return;
+
+	const float sin_angle = sinf(motion->angle), cos_angle = cosf(motion->angle);
+	v3 start_corners[2];
+	memcpy(start_corners, corners, sizeof(v3[2]));
+	float max_radius_sqr = 0.f;
+	size_t i, j;
+	for (i = 0; i < 8; i++) {
+		v3 corner = { start_corners[i & 1][X], start_corners[(i >> 1) & 1][Y], start_corners[i >> 2][Z] }, end_corner;
+		sub3v(corner, motion->center, corner);
+		max_radius_sqr = fmaxf(max_radius_sqr, magsqr3(corner));
+		motion_rotate(motion, sin_angle, cos_angle, corner, end_corner);
+		add3v3(end_corner, motion->center, motion->translation, end_corner);
+		for (j = 0; j < 3; j++) {
+			corners[0][j] = fminf(corners[0][j], end_corner[j]);
+			corners[1][j] = fmaxf(corners[1][j], end_corner[j]);
+		}
+	}
+	float sagitta = sqrtf(max_radius_sqr) * (1.f - cosf(motion->angle * 0.5f));
+	sub3s(corners[0], sagitta, corners[0]);
+	add3s(corners[1], sagitta, corners[1]);
+}
+
+void object_get_clipped_corners(const struct Object *object, v3 bounds[2], v3 corners[2])
+{
+	if (likely(!object->motion)) {
+		object->object_data->get_clipped_corners(object, bounds, corners);
+		return;
+	}
+
+	object_get_corners(object, corners);
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		corners[0][i] = fmaxf(corners[0][i], bounds[0][i]);
+		corners[1][i] = fminf(corners[1][i], bounds[1][i]);
+	}
+}
+
 /*******************************************************************************
 *	Sphere
 *******************************************************************************/
@@ -238,7 +635,7 @@ void sphere_postinit(struct Object *object)
 
 struct Object *sphere_new(const v3 position, const float radius)
 {
-	struct Sphere *sphere = safe_malloc(sizeof(struct Sphere));
+	struct Sphere *sphere = arena_alloc(&object_arena, sizeof(struct Sphere));
 
 	sphere->radius = radius;
 	assign3(sphere->position, position);
@@ -246,11 +643,6 @@ struct Object *sphere_new(const v3 position, const float radius)
 	return (struct Object *)sphere;
 }
 
-void sphere_delete(struct Object *object)
-{
-	free(object);
-}
-
 bool sphere_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal)
 {
 	struct Sphere *sphere = (struct Sphere *)object;
@@ -303,6 +695,20 @@ void sphere_get_light_point(const struct Object *object, const v3 point, v3 ligh
 	add3v(sphere->position, light_direction, light_point);
 }
 
+void sphere_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS])
+{
+	struct Sphere *sphere = (struct Sphere *)object;
+	assign3(parameters, sphere->position);
+	parameters[3] = sphere->radius;
+}
+
+void sphere_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation)
+{
+	struct Sphere *sphere = (struct Sphere *)object;
+	mulmv(rotation, parameters, sphere->position);
+	add3v(sphere->position, translation, sphere->position);
+}
+
 bool line_intersects_sphere(const v3 sphere_position, const float sphere_radius, const v3 line_position, const v3 line_vector, const float epsilon, float *distance)
 {
 	v3 relative_position;
@@ -331,32 +737,27 @@ void triangle_postinit(struct Object *object)
 	sub3v(triangle->vertices[1], triangle->vertices[0], triangle->edges[0]);
 	sub3v(triangle->vertices[2], triangle->vertices[0], triangle->edges[1]);
 	cross(triangle->edges[0], triangle->edges[1], triangle->normal);
+	float area = 0.5f * mag3(triangle->normal);
 	norm3(triangle->normal);
 
-	if (triangle->object.epsilon == -1.f) {
-		float magab = mag3(triangle->edges[0]) * mag3(triangle->edges[1]);
-		triangle->object.epsilon = 0.003f * powf(0.5f * magab * sinf(acosf(dot3(triangle->edges[0], triangle->edges[1]) / magab)), 0.75f);
-	}
+	//Intersections are watertight and do not use epsilon
+	if (triangle->object.epsilon == -1.f)
+		triangle->object.epsilon = 0.003f * powf(area, 0.75f);
 }
 
 struct Object *triangle_new(v3 vertices[3])
 {
-	struct Triangle *triangle = safe_malloc(sizeof(struct Triangle));
+	struct Triangle *triangle = arena_alloc(&object_arena, sizeof(struct Triangle));
 
 	memcpy(triangle->vertices, vertices, sizeof(v3[3]));
 
 	return (struct Object *)triangle;
 }
 
-void triangle_delete(struct Object *object)
-{
-	free(object);
-}
-
 bool triangle_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal)
 {
 	struct Triangle *triangle = (struct Triangle *)object;
-	bool intersects = moller_trumbore(triangle->vertices[0], triangle->edges, ray->point, ray->direction, triangle->object.epsilon, distance);
+	bool intersects = line_intersects_triangle(triangle->vertices, ray->point, ray->direction, distance);
 	if (intersects) {
 		assign3(normal, triangle->normal);
 		return true;
@@ -368,7 +769,7 @@ bool triangle_intersects_in_range(const struct Object *object, const struct Ray
 {
 	struct Triangle *triangle = (struct Triangle *)object;
 	float distance;
-	bool intersects = moller_trumbore(triangle->vertices[0], triangle->edges, ray->point, ray->direction, triangle->object.epsilon, &distance);
+	bool intersects = line_intersects_triangle(triangle->vertices, ray->point, ray->direction, &distance);
 	return intersects && distance < min_distance;
 }
 
@@ -418,26 +819,642 @@ void triangle_get_light_point(const struct Object *object, const v3 point, v3 li
 		light_point[i] = triangle->vertices[0][i] + (triangle->vertices[1][i] - triangle->vertices[0][i]) * p + (triangle->vertices[2][i] - triangle->vertices[0][i]) * q;
 }
 
-//Möller–Trumbore intersection algorithm
-bool moller_trumbore(const v3 vertex, v3 edges[2], const v3 line_position, const v3 line_vector, const float epsilon, float *distance)
+void triangle_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS])
+{
+	struct Triangle *triangle = (struct Triangle *)object;
+	memcpy(parameters, triangle->vertices, sizeof(v3[3]));
+}
+
+void triangle_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation)
+{
+	struct Triangle *triangle = (struct Triangle *)object;
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		mulmv(rotation, &parameters[3 * i], triangle->vertices[i]);
+		add3v(triangle->vertices[i], translation, triangle->vertices[i]);
+	}
+	triangle_postinit(object);
+}
+
+//Sutherland-Hodgman clipping of triangle by each face of cuboid
+void triangle_get_clipped_corners(const struct Object *object, v3 bounds[2], v3 corners[2])
+{
+	struct Triangle *triangle = (struct Triangle *)object;
+	v3 polygons[2][9]; //Each face adds at most one vertex
+	size_t num_vertices = 3, cur = 0;
+	memcpy(polygons[0], triangle->vertices, sizeof(v3[3]));
+
+	size_t axis, side, i;
+	for (axis = 0; axis < 3 && num_vertices; axis++) {
+		for (side = 0; side < 2 && num_vertices; side++) {
+			const float plane = bounds[side][axis];
+			v3 *polygon = polygons[cur];
+			v3 *clipped = polygons[cur ^ 1];
+			size_t num_clipped = 0;
+			for (i = 0; i < num_vertices; i++) {
+				const float *a = polygon[i], *b = polygon[(i + 1) % num_vertices];
+				float dist_a = side ? plane - a[axis] : a[axis] - plane;
+				float dist_b = side ? plane - b[axis] : b[axis] - plane;
+				if (dist_a >= 0.f)
+					assign3(clipped[num_clipped++], a);
+				if ((dist_a >= 0.f) != (dist_b >= 0.f)) {
+					float t = dist_a / (dist_a - dist_b);
+					v3 edge;
+					sub3v(b, a, edge);
+					mul3s(edge, t, edge);
+					add3v(a, edge, clipped[num_clipped]);
+					clipped[num_clipped++][axis] = plane;
+				}
+			}
+			num_vertices = num_clipped;
+			cur ^= 1;
+		}
+	}
+
+	// clang-format off
+	corners[0][X] = FLT_MAX; corners[0][Y] = FLT_MAX; corners[0][Z] = FLT_MAX;
+	corners[1][X] = -FLT_MAX; corners[1][Y] = -FLT_MAX; corners[1][Z] = -FLT_MAX;
+	// clang-format on
+	for (i = 0; i < num_vertices; i++) {
+		for (axis = 0; axis < 3; axis++) {
+			corners[0][axis] = fmaxf(fminf(corners[0][axis], polygons[cur][i][axis]), bounds[0][axis]);
+			corners[1][axis] = fminf(fmaxf(corners[1][axis], polygons[cur][i][axis]), bounds[1][axis]);
+		}
+	}
+}
+
+//Watertight ray-triangle intersection (Woop, Benthin, Wald). Points on an edge shared by two triangles hit at least one of them
+bool line_intersects_triangle(v3 vertices[3], const v3 line_position, const v3 line_vector, float *distance)
+{
+	//Shear and scale space so that the line runs along the +kz axis
+	size_t kz = fabsf(line_vector[X]) > fabsf(line_vector[Y])
+		? (fabsf(line_vector[X]) > fabsf(line_vector[Z]) ? X : Z)
+		: (fabsf(line_vector[Y]) > fabsf(line_vector[Z]) ? Y : Z);
+	size_t kx = (kz + 1) % 3, ky = (kx + 1) % 3;
+	if (line_vector[kz] < 0.f) { //Preserve winding
+		size_t k = kx;
+		kx = ky;
+		ky = k;
+	}
+	const float sz = 1.f / line_vector[kz];
+	const float sx = line_vector[kx] * sz, sy = line_vector[ky] * sz;
+
+	v3 a, b, c;
+	sub3v(vertices[0], line_position, a);
+	sub3v(vertices[1], line_position, b);
+	sub3v(vertices[2], line_position, c);
+	const float ax = a[kx] - sx * a[kz], ay = a[ky] - sy * a[kz];
+	const float bx = b[kx] - sx * b[kz], by = b[ky] - sy * b[kz];
+	const float cx = c[kx] - sx * c[kz], cy = c[ky] - sy * c[kz];
+
+	//Scaled barycentric coordinates, recomputed in double precision if the line passes through an edge
+	float u = cx * by - cy * bx;
+	float v = ax * cy - ay * cx;
+	float w = bx * ay - by * ax;
+	if (unlikely(u == 0.f || v == 0.f || w == 0.f)) {
+		u = (float)((double)cx * (double)by - (double)cy * (double)bx);
+		v = (float)((double)ax * (double)cy - (double)ay * (double)cx);
+		w = (float)((double)bx * (double)ay - (double)by * (double)ax);
+	}
+	if ((u < 0.f || v < 0.f || w < 0.f) && (u > 0.f || v > 0.f || w > 0.f))
+		return false;
+	const float det = u + v + w;
+	if (unlikely(det == 0.f)) //line is parallel to triangle
+		return false;
+
+	*distance = (u * a[kz] + v * b[kz] + w * c[kz]) * sz / det;
+	return *distance > 0.f;
+}
+
+/*******************************************************************************
+*	Quad
+*******************************************************************************/
+
+void quad_postinit(struct Object *object)
+{
+	struct Quad *quad = (struct Quad *)object;
+
+	v3 perpendicular;
+	cross(quad->edges[0], quad->edges[1], perpendicular);
+	float area = mag3(perpendicular);
+	mul3s(perpendicular, 1.f / area, quad->normal);
+	mul3s(perpendicular, 1.f / sqr(area), quad->w);
+
+	if (quad->object.epsilon == -1.f)
+		quad->object.epsilon = sqrtf(area) * 0.0003f;
+}
+
+struct Object *quad_new(const v3 position, v3 edges[2])
+{
+	struct Quad *quad = arena_alloc(&object_arena, sizeof(struct Quad));
+
+	assign3(quad->position, position);
+	memcpy(quad->edges, edges, sizeof(v3[2]));
+
+	return (struct Object *)quad;
+}
+
+//Intersects plane of quad, then checks that the point's coordinates along both edges are in [0,1]. Normal faces the ray, as quads are two-sided
+bool quad_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal)
+{
+	struct Quad *quad = (struct Quad *)object;
+	float a = dot3(quad->normal, ray->direction);
+	if (unlikely(a == 0.f)) //ray is parallel to quad
+		return false;
+	v3 relative_position;
+	sub3v(quad->position, ray->point, relative_position);
+	*distance = dot3(quad->normal, relative_position) / a;
+	if (*distance <= quad->object.epsilon)
+		return false;
+
+	v3 offset, perpendicular;
+	mul3s(ray->direction, *distance, offset);
+	sub3v(offset, relative_position, offset);
+	cross(offset, quad->edges[1], perpendicular);
+	float alpha = dot3(quad->w, perpendicular);
+	if (alpha < 0.f || alpha > 1.f)
+		return false;
+	cross(quad->edges[0], offset, perpendicular);
+	float beta = dot3(quad->w, perpendicular);
+	if (beta < 0.f || beta > 1.f)
+		return false;
+
+	if (signbit(a))
+		assign3(normal, quad->normal);
+	else
+		mul3s(quad->normal, -1.f, normal);
+	return true;
+}
+
+bool quad_intersects_in_range(const struct Object *object, const struct Ray *ray, const float min_distance)
+{
+	float distance;
+	v3 normal;
+	return quad_get_intersection(object, ray, &distance, normal) && distance < min_distance;
+}
+
+void quad_get_corners(const struct Object *object, v3 corners[2])
+{
+	struct Quad *quad = (struct Quad *)object;
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		float edge_min = fminf(quad->edges[0][i], 0.f) + fminf(quad->edges[1][i], 0.f);
+		float edge_max = fmaxf(quad->edges[0][i], 0.f) + fmaxf(quad->edges[1][i], 0.f);
+		corners[0][i] = quad->position[i] + edge_min;
+		corners[1][i] = quad->position[i] + edge_max;
+	}
+}
+
+void quad_scale(const struct Object *object, const v3 neg_shift, const float scale)
+{
+	struct Quad *quad = (struct Quad *)object;
+	quad->object.epsilon *= scale;
+	sub3v(quad->position, neg_shift, quad->position);
+	mul3s(quad->position, scale, quad->position);
+	mul3s(quad->edges[0], scale, quad->edges[0]);
+	mul3s(quad->edges[1], scale, quad->edges[1]);
+	mul3s(quad->w, 1.f / sqr(scale), quad->w);
+}
+
+void quad_get_light_point(const struct Object *object, const v3 point, v3 light_point)
+{
+	(void)point;
+	struct Quad *quad = (struct Quad *)object;
+	float p = rand_flt(), q = rand_flt();
+	size_t i;
+	for (i = 0; i < 3; i++)
+		light_point[i] = quad->position[i] + quad->edges[0][i] * p + quad->edges[1][i] * q;
+}
+
+void quad_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS])
+{
+	struct Quad *quad = (struct Quad *)object;
+	assign3(parameters, quad->position);
+	memcpy(&parameters[3], quad->edges, sizeof(v3[2]));
+}
+
+void quad_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation)
+{
+	struct Quad *quad = (struct Quad *)object;
+	mulmv(rotation, parameters, quad->position);
+	add3v(quad->position, translation, quad->position);
+	mulmv(rotation, &parameters[3], quad->edges[0]);
+	mulmv(rotation, &parameters[6], quad->edges[1]);
+	quad_postinit(object);
+}
+
+/*******************************************************************************
+*	Disc
+*******************************************************************************/
+
+void disc_postinit(struct Object *object)
+{
+	struct Disc *disc = (struct Disc *)object;
+
+	get_tangents(disc->normal, disc->tangents);
+
+	if (disc->object.epsilon == -1.f)
+		disc->object.epsilon = disc->radius * 0.0003f;
+}
+
+struct Object *disc_new(const v3 position, const v3 normal, const float radius)
+{
+	struct Disc *disc = arena_alloc(&object_arena, sizeof(struct Disc));
+
+	assign3(disc->position, position);
+	assign3(disc->normal, normal);
+	norm3(disc->normal);
+	disc->radius = radius;
+
+	return (struct Object *)disc;
+}
+
+//Normal faces the ray, as discs are two-sided
+bool disc_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal)
+{
+	struct Disc *disc = (struct Disc *)object;
+	if (!line_intersects_disc(disc->position, disc->normal, disc->radius, ray->point, ray->direction, disc->object.epsilon, distance))
+		return false;
+	if (signbit(dot3(disc->normal, ray->direction)))
+		assign3(normal, disc->normal);
+	else
+		mul3s(disc->normal, -1.f, normal);
+	return true;
+}
+
+bool disc_intersects_in_range(const struct Object *object, const struct Ray *ray, const float min_distance)
+{
+	struct Disc *disc = (struct Disc *)object;
+	float distance;
+	return line_intersects_disc(disc->position, disc->normal, disc->radius, ray->point, ray->direction, disc->object.epsilon, &distance) && distance < min_distance;
+}
+
+void disc_get_corners(const struct Object *object, v3 corners[2])
+{
+	struct Disc *disc = (struct Disc *)object;
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		float extent = disc->radius * sqrtf(fmaxf(1.f - sqr(disc->normal[i]), 0.f));
+		corners[0][i] = disc->position[i] - extent;
+		corners[1][i] = disc->position[i] + extent;
+	}
+}
+
+void disc_scale(const struct Object *object, const v3 neg_shift, const float scale)
+{
+	struct Disc *disc = (struct Disc *)object;
+	disc->object.epsilon *= scale;
+	disc->radius *= scale;
+	sub3v(disc->position, neg_shift, disc->position);
+	mul3s(disc->position, scale, disc->position);
+}
+
+void disc_get_light_point(const struct Object *object, const v3 point, v3 light_point)
+{
+	(void)point;
+	struct Disc *disc = (struct Disc *)object;
+	float radius = disc->radius * sqrtf(rand_flt());
+	float angle = rand_flt() * 2.f * PI;
+	float p = radius * cosf(angle), q = radius * sinf(angle);
+	size_t i;
+	for (i = 0; i < 3; i++)
+		light_point[i] = disc->position[i] + disc->tangents[0][i] * p + disc->tangents[1][i] * q;
+}
+
+void disc_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS])
+{
+	struct Disc *disc = (struct Disc *)object;
+	assign3(parameters, disc->position);
+	assign3(&parameters[3], disc->normal);
+	parameters[6] = disc->radius;
+}
+
+void disc_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation)
+{
+	struct Disc *disc = (struct Disc *)object;
+	mulmv(rotation, parameters, disc->position);
+	add3v(disc->position, translation, disc->position);
+	mulmv(rotation, &parameters[3], disc->normal);
+	disc_postinit(object);
+}
+
+bool line_intersects_disc(const v3 disc_position, const v3 disc_normal, const float disc_radius, const v3 line_position, const v3 line_vector, const float epsilon, float *distance)
 {
-	float a, f, u, v;
-	v3 h, s, q;
-	cross(line_vector, edges[1], h);
-	a = dot3(edges[0], h);
-	if (unlikely(a < epsilon && a > -epsilon)) //ray is parallel to line
+	float a = dot3(disc_normal, line_vector);
+	if (unlikely(a == 0.f)) //ray is parallel to disc
 		return false;
-	f = 1.f / a;
-	sub3v(line_position, vertex, s);
-	u = f * dot3(s, h);
-	if (u < 0.f || u > 1.f)
+	v3 relative_position;
+	sub3v(disc_position, line_position, relative_position);
+	*distance = dot3(disc_normal, relative_position) / a;
+	if (*distance <= epsilon)
+		return false;
+	v3 offset;
+	mul3s(line_vector, *distance, offset);
+	sub3v(offset, relative_position, offset);
+	return magsqr3(offset) <= sqr(disc_radius);
+}
+
+/*******************************************************************************
+*	Cylinder
+*******************************************************************************/
+
+void cylinder_postinit(struct Object *object)
+{
+	struct Cylinder *cylinder = (struct Cylinder *)object;
+
+	get_tangents(cylinder->axis, cylinder->tangents);
+
+	if (cylinder->object.epsilon == -1.f)
+		cylinder->object.epsilon = fmaxf(cylinder->radius, cylinder->height) * 0.0003f;
+}
+
+struct Object *cylinder_new(const v3 position, const v3 axis, const float radius)
+{
+	struct Cylinder *cylinder = arena_alloc(&object_arena, sizeof(struct Cylinder));
+
+	assign3(cylinder->position, position);
+	cylinder->height = mag3(axis);
+	mul3s(axis, 1.f / cylinder->height, cylinder->axis);
+	cylinder->radius = radius;
+
+	return (struct Object *)cylinder;
+}
+
+//Closest intersection with the side, which is an infinite cylinder cut to height, or either cap. Normal points outwards
+bool cylinder_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal)
+{
+	struct Cylinder *cylinder = (struct Cylinder *)object;
+	const float epsilon = cylinder->object.epsilon;
+	v3 relative_position, direction_perpendicular, position_perpendicular;
+	sub3v(ray->point, cylinder->position, relative_position);
+	float direction_axial = dot3(ray->direction, cylinder->axis);
+	float position_axial = dot3(relative_position, cylinder->axis);
+	mul3s(cylinder->axis, direction_axial, direction_perpendicular);
+	sub3v(ray->direction, direction_perpendicular, direction_perpendicular);
+	mul3s(cylinder->axis, position_axial, position_perpendicular);
+	sub3v(relative_position, position_perpendicular, position_perpendicular);
+
+	bool intersects = false;
+	float a = magsqr3(direction_perpendicular);
+	if (a > 0.f) {
+		float b = -dot3(direction_perpendicular, position_perpendicular);
+		float det = sqr(b) - a * (magsqr3(position_perpendicular) - sqr(cylinder->radius));
+		if (det >= 0.f) {
+			float sqrt_det = sqrtf(det);
+			float side_distances[2] = { (b - sqrt_det) / a, (b + sqrt_det) / a };
+			size_t i;
+			for (i = 0; i < 2; i++) {
+				float height = position_axial + side_distances[i] * direction_axial;
+				if (side_distances[i] > epsilon && height >= 0.f && height <= cylinder->height) {
+					*distance = side_distances[i];
+					mul3s(direction_perpendicular, *distance, normal);
+					add3v(normal, position_perpendicular, normal);
+					mul3s(normal, 1.f / cylinder->radius, normal);
+					intersects = true;
+					break;
+				}
+			}
+		}
+	}
+
+	v3 top;
+	mul3s(cylinder->axis, cylinder->height, top);
+	add3v(top, cylinder->position, top);
+	float cap_distance;
+	if (line_intersects_disc(cylinder->position, cylinder->axis, cylinder->radius, ray->point, ray->direction, epsilon, &cap_distance)
+		&& (!intersects || cap_distance < *distance)) {
+		*distance = cap_distance;
+		mul3s(cylinder->axis, -1.f, normal);
+		intersects = true;
+	}
+	if (line_intersects_disc(top, cylinder->axis, cylinder->radius, ray->point, ray->direction, epsilon, &cap_distance)
+		&& (!intersects || cap_distance < *distance)) {
+		*distance = cap_distance;
+		assign3(normal, cylinder->axis);
+		intersects = true;
+	}
+	return intersects;
+}
+
+bool cylinder_intersects_in_range(const struct Object *object, const struct Ray *ray, const float min_distance)
+{
+	float distance;
+	v3 normal;
+	return cylinder_get_intersection(object, ray, &distance, normal) && distance < min_distance;
+}
+
+void cylinder_get_corners(const struct Object *object, v3 corners[2])
+{
+	struct Cylinder *cylinder = (struct Cylinder *)object;
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		float extent = cylinder->radius * sqrtf(fmaxf(1.f - sqr(cylinder->axis[i]), 0.f));
+		float top = cylinder->position[i] + cylinder->axis[i] * cylinder->height;
+		corners[0][i] = fminf(cylinder->position[i], top) - extent;
+		corners[1][i] = fmaxf(cylinder->position[i], top) + extent;
+	}
+}
+
+void cylinder_scale(const struct Object *object, const v3 neg_shift, const float scale)
+{
+	struct Cylinder *cylinder = (struct Cylinder *)object;
+	cylinder->object.epsilon *= scale;
+	cylinder->radius *= scale;
+	cylinder->height *= scale;
+	sub3v(cylinder->position, neg_shift, cylinder->position);
+	mul3s(cylinder->position, scale, cylinder->position);
+}
+
+//Chooses the side or the cap nearer to point in proportion to their areas
+void cylinder_get_light_point(const struct Object *object, const v3 point, v3 light_point)
+{
+	struct Cylinder *cylinder = (struct Cylinder *)object;
+	float angle = rand_flt() * 2.f * PI;
+	float radius, height;
+	if (rand_flt() * (2.f * cylinder->height + cylinder->radius) < 2.f * cylinder->height) { //2 pi r h against pi r^2
+		radius = cylinder->radius;
+		height = rand_flt() * cylinder->height;
+	} else {
+		v3 relative_position;
+		sub3v(point, cylinder->position, relative_position);
+		radius = cylinder->radius * sqrtf(rand_flt());
+		height = (dot3(relative_position, cylinder->axis) > 0.5f * cylinder->height) ? cylinder->height : 0.f;
+	}
+	float p = radius * cosf(angle), q = radius * sinf(angle);
+	size_t i;
+	for (i = 0; i < 3; i++)
+		light_point[i] = cylinder->position[i] + cylinder->axis[i] * height + cylinder->tangents[0][i] * p + cylinder->tangents[1][i] * q;
+}
+
+void cylinder_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS])
+{
+	struct Cylinder *cylinder = (struct Cylinder *)object;
+	assign3(parameters, cylinder->position);
+	mul3s(cylinder->axis, cylinder->height, &parameters[3]);
+	parameters[6] = cylinder->radius;
+}
+
+void cylinder_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation)
+{
+	struct Cylinder *cylinder = (struct Cylinder *)object;
+	mulmv(rotation, parameters, cylinder->position);
+	add3v(cylinder->position, translation, cylinder->position);
+	mulmv(rotation, &parameters[3], cylinder->axis);
+	mul3s(cylinder->axis, 1.f / cylinder->height, cylinder->axis);
+	cylinder_postinit(object);
+}
+
+/*******************************************************************************
+*	Box
+*******************************************************************************/
+
+void box_postinit(struct Object *object)
+{
+	struct Box *box = (struct Box *)object;
+
+	if (box->object.epsilon == -1.f)
+		box->object.epsilon = mag3(box->half_size) * 0.0003f;
+}
+
+//Rotation is about the X, Y, then Z axis, as for meshes
+struct Object *box_new(const v3 position, const v3 size, const v3 rotation)
+{
+	struct Box *box = arena_alloc(&object_arena, sizeof(struct Box));
+
+	assign3(box->position, position);
+	mul3s(size, 0.5f, box->half_size);
+	m3 transform;
+	mesh_get_transform(rotation, 1.f, transform);
+	size_t i, j;
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			box->axes[i][j] = transform[j][i];
+
+	return (struct Object *)box;
+}
+
+//Slab test in the box's space. Normal points outwards
+bool box_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal)
+{
+	struct Box *box = (struct Box *)object;
+	v3 relative_position, point, direction;
+	sub3v(ray->point, box->position, relative_position);
+	mulmv(box->axes, relative_position, point);
+	mulmv(box->axes, ray->direction, direction);
+
+	float near = -FLT_MAX, far = FLT_MAX;
+	size_t near_axis = X, far_axis = X;
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		float div = 1.f / direction[i];
+		float t1 = (-box->half_size[i] - point[i]) * div;
+		float t2 = (box->half_size[i] - point[i]) * div;
+		if (div < 0.f) {
+			float tmp = t1;
+			t1 = t2;
+			t2 = tmp;
+		}
+		if (t1 > near) {
+			near = t1;
+			near_axis = i;
+		}
+		if (t2 < far) {
+			far = t2;
+			far_axis = i;
+		}
+	}
+	if (near > far)
 		return false;
-	cross(s, edges[0], q);
-	v = f * dot3(line_vector, q);
-	if (v < 0.f || u + v > 1.f)
+
+	if (near > box->object.epsilon) {
+		*distance = near;
+		mul3s(box->axes[near_axis], signbit(direction[near_axis]) ? 1.f : -1.f, normal);
+	} else if (far > box->object.epsilon) { //ray starts inside box
+		*distance = far;
+		mul3s(box->axes[far_axis], signbit(direction[far_axis]) ? -1.f : 1.f, normal);
+	} else {
 		return false;
-	*distance = f * dot3(edges[1], q);
-	return *distance > epsilon;
+	}
+	return true;
+}
+
+bool box_intersects_in_range(const struct Object *object, const struct Ray *ray, const float min_distance)
+{
+	float distance;
+	v3 normal;
+	return box_get_intersection(object, ray, &distance, normal) && distance < min_distance;
+}
+
+void box_get_corners(const struct Object *object, v3 corners[2])
+{
+	struct Box *box = (struct Box *)object;
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		float extent = fabsf(box->axes[X][i]) * box->half_size[X] + fabsf(box->axes[Y][i]) * box->half_size[Y] + fabsf(box->axes[Z][i]) * box->half_size[Z];
+		corners[0][i] = box->position[i] - extent;
+		corners[1][i] = box->position[i] + extent;
+	}
+}
+
+void box_scale(const struct Object *object, const v3 neg_shift, const float scale)
+{
+	struct Box *box = (struct Box *)object;
+	box->object.epsilon *= scale;
+	mul3s(box->half_size, scale, box->half_size);
+	sub3v(box->position, neg_shift, box->position);
+	mul3s(box->position, scale, box->position);
+}
+
+//Chooses a face which faces point in proportion to its area
+void box_get_light_point(const struct Object *object, const v3 point, v3 light_point)
+{
+	struct Box *box = (struct Box *)object;
+	v3 relative_position, local_point, areas;
+	sub3v(point, box->position, relative_position);
+	mulmv(box->axes, relative_position, local_point);
+	areas[X] = box->half_size[Y] * box->half_size[Z];
+	areas[Y] = box->half_size[X] * box->half_size[Z];
+	areas[Z] = box->half_size[X] * box->half_size[Y];
+	float area = rand_flt() * (areas[X] + areas[Y] + areas[Z]);
+	size_t face = (area < areas[X]) ? X : (area < areas[X] + areas[Y]) ? Y : Z;
+
+	v3 offset;
+	size_t i;
+	for (i = 0; i < 3; i++)
+		offset[i] = (i == face) ? copysignf(box->half_size[i], local_point[i]) : (rand_flt() * 2.f - 1.f) * box->half_size[i];
+	for (i = 0; i < 3; i++)
+		light_point[i] = box->position[i] + box->axes[X][i] * offset[X] + box->axes[Y][i] * offset[Y] + box->axes[Z][i] * offset[Z];
+}
+
+//Rotation is recovered from axes as angles about the X, Y, then Z axis
+void box_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS])
+{
+	struct Box *box = (struct Box *)object;
+	assign3(parameters, box->position);
+	mul3s(box->half_size, 2.f, &parameters[3]);
+	float *rotation = &parameters[6];
+	float sin_y = -box->axes[X][Z];
+	rotation[Y] = asinf(clamp(sin_y, -1.f, 1.f));
+	if (fabsf(sin_y) < 0.99999f) {
+		rotation[X] = atan2f(box->axes[Y][Z], box->axes[Z][Z]);
+		rotation[Z] = atan2f(box->axes[X][Y], box->axes[X][X]);
+	} else { //Gimbal lock, so rotation about the Z axis is folded into rotation about the X axis
+		rotation[X] = atan2f(box->axes[Y][X] * sin_y, box->axes[Y][Y]);
+		rotation[Z] = 0.f;
+	}
+}
+
+void box_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation)
+{
+	struct Box *box = (struct Box *)object;
+	mulmv(rotation, parameters, box->position);
+	add3v(box->position, translation, box->position);
+	m3 transform;
+	mesh_get_transform(&parameters[6], 1.f, transform);
+	size_t i, j;
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++) //transpose(rotation * transform)
+			box->axes[j][i] = rotation[i][X] * transform[X][j] + rotation[i][Y] * transform[Y][j] + rotation[i][Z] * transform[Z][j];
 }
 
 /*******************************************************************************
@@ -456,20 +1473,16 @@ void plane_postinit(struct Object *object)
 
 struct Object *plane_new(v3 position, v3 normal)
 {
-	struct Plane *plane = safe_malloc(sizeof(struct Plane));
+	struct Plane *plane = arena_alloc(&object_arena, sizeof(struct Plane));
 
 	assign3(plane->normal, normal);
 	norm3(plane->normal);
 	plane->d = dot3(plane->normal, position);
+	plane_update_crosses_corners(plane);
 
 	return (struct Object *)plane;
 }
 
-void plane_delete(struct Object *object)
-{
-	free(object);
-}
-
 bool plane_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal)
 {
 	struct Plane *plane = (struct Plane *)object;
@@ -511,42 +1524,79 @@ void plane_scale(const struct Object *object, const v3 neg_shift, const float sc
 	mul3s(point, scale, point);
 	plane->d = dot3(plane->normal, point);
 	plane->object.epsilon *= scale;
+	plane_update_crosses_corners(plane);
 }
-#endif /* UNBOUND_OBJECTS */
 
-/*******************************************************************************
-*	Mesh
-*******************************************************************************/
-
-void mesh_to_objects(const char *filename, struct Object *object, const v3 position, const v3 rotation, const float scale, size_t *i_object)
+void plane_get_parameters(const struct Object *object, float parameters[OBJECT_MAX_PARAMETERS])
 {
-	FILE *file = fopen(filename, "rb");
-	error_check(file, "Failed to open mesh file %s.", filename);
+	struct Plane *plane = (struct Plane *)object;
+	assign3(parameters, plane->normal);
+	parameters[3] = plane->d;
+}
 
-	stl_load_objects(file, filename, object, position, rotation, scale, i_object);
+void plane_transform(struct Object *object, const float parameters[OBJECT_MAX_PARAMETERS], m3 rotation, const v3 translation)
+{
+	struct Plane *plane = (struct Plane *)object;
+	mulmv(rotation, parameters, plane->normal);
+	plane->d = parameters[3] + dot3(plane->normal, translation);
+	plane_update_crosses_corners(plane);
+}
 
-	fclose(file);
+//Plane crosses cuboid if its distance from the center is at most the cuboid's extent along the normal
+void plane_update_crosses_corners(struct Plane *plane)
+{
+	float distance = plane->d, extent = 0.f;
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		distance -= plane->normal[i] * 0.5f * (plane_corners[0][i] + plane_corners[1][i]);
+		extent += fabsf(plane->normal[i]) * 0.5f * (plane_corners[1][i] - plane_corners[0][i]);
+	}
+	plane->crosses_corners = fabsf(distance) <= extent;
 }
 
-uint32_t stl_get_num_triangles(FILE *file)
+bool plane_corners_contain(const v3 point)
 {
-	int fseek_ret = fseek(file, sizeof(uint8_t) * 80, SEEK_SET);
-	error_check(!fseek_ret, "Failed to read header of mesh file.");
-	uint32_t num_triangles;
-	size_t nmemb_read = fread(&num_triangles, sizeof(uint32_t), 1, file);
-	error_check(nmemb_read == 1, "Failed to read triangle count in mesh file.");
-	return num_triangles;
+	return point[X] >= plane_corners[0][X] && point[X] <= plane_corners[1][X]
+		&& point[Y] >= plane_corners[0][Y] && point[Y] <= plane_corners[1][Y]
+		&& point[Z] >= plane_corners[0][Z] && point[Z] <= plane_corners[1][Z];
 }
+#endif /* UNBOUND_OBJECTS */
 
-//assumes that file is at SEEK_SET
-void stl_load_objects(FILE *file, const char *filename, struct Object *object, const v3 position, const v3 rot, const float scale, size_t *i_object)
+/*******************************************************************************
+*	Mesh
+*******************************************************************************/
+
+void mesh_to_objects(const char *filename, struct Object *object, const v3 position, const v3 rotation, const float scale, size_t *i_object)
 {
-	//ensure that file is binary instead of ascii
-	char header[5];
-	size_t nmemb_read = fread(header, sizeof(char), 5, file);
-	error_check(nmemb_read == 5, "Failed to read header of mesh file [%s].", filename);
-	error_check(strncmp("solid", header, 5), "Mesh file [%s] does not use binary encoding.", filename);
+	double t = trace_time();
+	int fd = open(filename, O_RDONLY);
+	error_check(fd >= 0, "Failed to open mesh file %s.", filename);
+	struct stat file_stat;
+	error_check(!fstat(fd, &file_stat), "Failed to read size of mesh file [%s].", filename);
+	size_t size = file_stat.st_size;
+	error_check(size, "Mesh file [%s] is empty.", filename);
+	const uint8_t *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	error_check(data != MAP_FAILED, "Failed to map mesh file [%s].", filename);
+	close(fd);
+
+	m3 transform;
+	mesh_get_transform(rotation, scale, transform);
+
+	const char *extension = strrchr(filename, '.');
+	if (extension && !strcmp(extension, ".obj"))
+		obj_load_objects((const char *)data, size, filename, object, transform, position, i_object);
+	else if (extension && !strcmp(extension, ".ply"))
+		ply_load_objects(data, size, filename, object, transform, position, i_object);
+	else
+		stl_load_objects(data, size, filename, object, transform, position, i_object);
+
+	munmap((void *)data, size);
+	trace_event("Mesh load", filename, t);
+}
 
+//Rotation about the X, Y, then Z axis, followed by scaling
+void mesh_get_transform(const v3 rot, const float scale, m3 transform)
+{
 	float a = cosf(rot[Z]) * sinf(rot[Y]);
 	float b = sinf(rot[Z]) * sinf(rot[Y]);
 	m3 rotation_matrix = {
@@ -560,28 +1610,358 @@ void stl_load_objects(FILE *file, const char *filename, struct Object *object, c
 			cosf(rot[Y]) * sinf(rot[X]),
 			cosf(rot[Y]) * cosf(rot[X]) }
 	};
+	mulms(rotation_matrix, scale, transform);
+}
 
-	uint32_t num_triangles = stl_get_num_triangles(file);
+//Grows objects to fit the triangles, which are allocated contiguously
+struct Triangle *mesh_triangles_new(const size_t num_triangles)
+{
 	num_objects += num_triangles - 1;
-	objects = safe_realloc(objects, sizeof(struct Object) * num_objects);
+	objects = safe_realloc(objects, sizeof(struct Object *) * num_objects);
+	return arena_alloc(&object_arena, sizeof(struct Triangle) * num_triangles);
+}
+
+//Transforms shared vertices once, then copies them into the triangles
+void mesh_indexed_to_objects(v3 *vertices, const size_t num_vertices, const uint32_t (*faces)[3], const size_t num_faces, const char *filename, const struct Object *object, m3 transform, const v3 position, size_t *i_object)
+{
+	size_t i;
+	for (i = 0; i < num_faces; i++)
+		error_check(faces[i][0] < num_vertices && faces[i][1] < num_vertices && faces[i][2] < num_vertices, "Face [%zu] of mesh file [%s] references nonexistent vertex.", i, filename);
+
+#ifdef MULTITHREADING
+#pragma omp parallel for
+#endif
+	for (size_t j = 0; j < num_vertices; j++) {
+		v3 vertex;
+		mulmv(transform, vertices[j], vertex);
+		add3v(vertex, position, vertices[j]);
+	}
+
+	struct Triangle *triangles = mesh_triangles_new(num_faces);
+	struct Object **mesh_objects = &objects[*i_object];
+
+#ifdef MULTITHREADING
+#pragma omp parallel for
+#endif
+	for (size_t j = 0; j < num_faces; j++) {
+		struct Triangle *triangle = &triangles[j];
+		memcpy(&triangle->object, object, sizeof(struct Object));
+		assign3(triangle->vertices[0], vertices[faces[j][0]]);
+		assign3(triangle->vertices[1], vertices[faces[j][1]]);
+		assign3(triangle->vertices[2], vertices[faces[j][2]]);
+		triangle_postinit(&triangle->object);
+		mesh_objects[j] = &triangle->object;
+	}
+	*i_object += num_faces;
+}
+
+//Triangles are parsed in parallel into a single allocation
+void stl_load_objects(const uint8_t *data, const size_t size, const char *filename, const struct Object *object, m3 transform, const v3 position, size_t *i_object)
+{
+	//ensure that file is binary instead of ascii
+	error_check(size >= STL_HEADER_SIZE, "Failed to read header of mesh file [%s].", filename);
+	error_check(strncmp("solid", (const char *)data, 5), "Mesh file [%s] does not use binary encoding.", filename);
+
+	uint32_t num_triangles;
+	memcpy(&num_triangles, data + STL_HEADER_SIZE - sizeof(uint32_t), sizeof(uint32_t));
+	error_check(size >= STL_HEADER_SIZE + (size_t)num_triangles * sizeof(struct STLTriangle), "Failed to read triangles in mesh file [%s].", filename);
+	const struct STLTriangle *stl_triangles = (const struct STLTriangle *)(data + STL_HEADER_SIZE);
 
-	uint32_t i;
-	for (i = 0; i < num_triangles; i++) {
-		struct STLTriangle stl_triangle;
-		nmemb_read = fread(&stl_triangle, sizeof(struct STLTriangle), 1, file);
-		error_check(nmemb_read == 1, "Failed to read triangle in mesh file [%s].", filename);
+	struct Triangle *triangles = mesh_triangles_new(num_triangles);
+	struct Object **mesh_objects = &objects[*i_object];
 
+#ifdef MULTITHREADING
+#pragma omp parallel for
+#endif
+	for (uint32_t i = 0; i < num_triangles; i++) {
+		struct Triangle *triangle = &triangles[i];
+		memcpy(&triangle->object, object, sizeof(struct Object));
 		uint32_t j;
 		for (j = 0; j < 3; j++) {
-			v3 temp_vertices;
-			mulmv(rotation_matrix, stl_triangle.vertices[j], temp_vertices);
-			mul3s(temp_vertices, scale, stl_triangle.vertices[j]);
-			add3v(stl_triangle.vertices[j], position, stl_triangle.vertices[j]);
+			mulmv(transform, stl_triangles[i].vertices[j], triangle->vertices[j]);
+			add3v(triangle->vertices[j], position, triangle->vertices[j]);
 		}
-		struct Object *triangle = triangle_new(stl_triangle.vertices);
-		memcpy(triangle, object, sizeof(struct Object));
-		triangle_postinit(triangle);
-		objects[*i_object] = triangle;
-		*i_object += 1;
+		triangle_postinit(&triangle->object);
+		mesh_objects[i] = &triangle->object;
 	}
+	*i_object += num_triangles;
+}
+
+//Parses a decimal number without reading past end, unlike strtof
+bool mesh_parse_number(const char **cp, const char *end, double *number)
+{
+	const char *c = *cp;
+	bool negative = false;
+	if (c < end && (*c == '-' || *c == '+'))
+		negative = *c++ == '-';
+	const char *digits = c;
+	double mantissa = 0.;
+	int exponent = 0;
+	for (; c < end && *c >= '0' && *c <= '9'; c++)
+		mantissa = mantissa * 10. + (*c - '0');
+	if (c < end && *c == '.')
+		for (c++; c < end && *c >= '0' && *c <= '9'; c++, exponent--)
+			mantissa = mantissa * 10. + (*c - '0');
+	if (c == digits)
+		return false;
+	if (c < end && (*c == 'e' || *c == 'E')) {
+		c++;
+		double e;
+		if (!mesh_parse_number(&c, end, &e))
+			return false;
+		exponent += (int)e;
+	}
+	*cp = c;
+	*number = (negative ? -mantissa : mantissa) * pow(10., exponent);
+	return true;
+}
+
+//Appends to a buffer which grows by doubling
+void *mesh_append(void *buffer, size_t *capacity, const size_t count, const size_t size)
+{
+	if (count < *capacity)
+		return buffer;
+	*capacity = *capacity ? *capacity * 2 : 1024;
+	return safe_realloc(buffer, *capacity * size);
+}
+
+//Supports v and f statements. Polygons are triangulated as fans. Other statements are ignored
+void obj_load_objects(const char *data, const size_t size, const char *filename, const struct Object *object, m3 transform, const v3 position, size_t *i_object)
+{
+	const char *c = data, *end = data + size;
+	v3 *vertices = NULL;
+	uint32_t(*faces)[3] = NULL;
+	size_t num_vertices = 0, num_faces = 0, max_vertices = 0, max_faces = 0;
+	size_t line = 1;
+
+	while (c < end) {
+		while (c < end && (*c == ' ' || *c == '\t'))
+			c++;
+		if (end - c > 1 && c[0] == 'v' && (c[1] == ' ' || c[1] == '\t')) {
+			c++;
+			vertices = mesh_append(vertices, &max_vertices, num_vertices, sizeof(v3));
+			size_t i;
+			for (i = 0; i < 3; i++) {
+				while (c < end && (*c == ' ' || *c == '\t'))
+					c++;
+				double coordinate;
+				error_check(mesh_parse_number(&c, end, &coordinate), "Expected vertex coordinate on line [%zu] of mesh file [%s].", line, filename);
+				vertices[num_vertices][i] = (float)coordinate;
+			}
+			num_vertices++;
+		} else if (end - c > 1 && c[0] == 'f' && (c[1] == ' ' || c[1] == '\t')) {
+			c++;
+			uint32_t polygon[3];
+			size_t num_polygon_vertices = 0;
+			for (;;) {
+				while (c < end && (*c == ' ' || *c == '\t'))
+					c++;
+				double index;
+				if (!mesh_parse_number(&c, end, &index))
+					break;
+				//Skip texture coordinate and normal indices
+				while (c < end && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n')
+					c++;
+				polygon[num_polygon_vertices < 2 ? num_polygon_vertices : 2] = (uint32_t)(index < 0. ? num_vertices + index : index - 1.);
+				if (++num_polygon_vertices >= 3) {
+					faces = mesh_append(faces, &max_faces, num_faces, sizeof(uint32_t[3]));
+					memcpy(faces[num_faces++], polygon, sizeof(polygon));
+					polygon[1] = polygon[2];
+				}
+			}
+			error_check(num_polygon_vertices >= 3, "Expected at least 3 vertices in face on line [%zu] of mesh file [%s].", line, filename);
+		}
+		while (c < end && *c++ != '\n')
+			;
+		line++;
+	}
+
+	printf_log("Loaded [%zu] vertices and [%zu] triangles from [%s].", num_vertices, num_faces, filename);
+	mesh_indexed_to_objects(vertices, num_vertices, (const uint32_t(*)[3])faces, num_faces, filename, object, transform, position, i_object);
+	free(vertices);
+	free(faces);
+}
+
+//Reads a scalar of a binary PLY property, advancing data
+double ply_read(const uint8_t **data, const uint8_t *end, const enum PLYType type, const bool big_endian, const char *filename)
+{
+	static const uint8_t PLY_TYPE_SIZE[] = {
+		[PLY_INT8] = 1,
+		[PLY_UINT8] = 1,
+		[PLY_INT16] = 2,
+		[PLY_UINT16] = 2,
+		[PLY_INT32] = 4,
+		[PLY_UINT32] = 4,
+		[PLY_FLOAT32] = 4,
+		[PLY_FLOAT64] = 8,
+	};
+	size_t size = PLY_TYPE_SIZE[type];
+	error_check((size_t)(end - *data) >= size, "Unexpected end of mesh file [%s].", filename);
+
+	uint8_t bytes[8];
+	size_t i;
+	for (i = 0; i < size; i++)
+		bytes[i] = (*data)[big_endian ? size - 1 - i : i];
+	*data += size;
+
+	union {
+		int8_t i8;
+		uint8_t u8;
+		int16_t i16;
+		uint16_t u16;
+		int32_t i32;
+		uint32_t u32;
+		float f32;
+		double f64;
+	} value;
+	memcpy(&value, bytes, size);
+
+	switch (type) {
+	case PLY_INT8:
+		return value.i8;
+	case PLY_UINT8:
+		return value.u8;
+	case PLY_INT16:
+		return value.i16;
+	case PLY_UINT16:
+		return value.u16;
+	case PLY_INT32:
+		return value.i32;
+	case PLY_UINT32:
+		return value.u32;
+	case PLY_FLOAT32:
+		return (double)value.f32;
+	case PLY_FLOAT64:
+		return value.f64;
+	}
+	UNREACHABLE;
+}
+
+enum PLYType ply_parse_type(const char *name, const char *filename)
+{
+	static const char *const PLY_TYPE_NAMES[][2] = {
+		[PLY_INT8] = { "char", "int8" },
+		[PLY_UINT8] = { "uchar", "uint8" },
+		[PLY_INT16] = { "short", "int16" },
+		[PLY_UINT16] = { "ushort", "uint16" },
+		[PLY_INT32] = { "int", "int32" },
+		[PLY_UINT32] = { "uint", "uint32" },
+		[PLY_FLOAT32] = { "float", "float32" },
+		[PLY_FLOAT64] = { "double", "float64" },
+	};
+	size_t i;
+	for (i = 0; i < arrlen(PLY_TYPE_NAMES); i++)
+		if (!strcmp(name, PLY_TYPE_NAMES[i][0]) || !strcmp(name, PLY_TYPE_NAMES[i][1]))
+			return i;
+	error("Unknown property type [%s] in mesh file [%s].", name, filename);
+	UNREACHABLE;
+}
+
+//Supports binary PLY with vertex x, y, z properties and face vertex_indices lists. Other elements and properties are skipped
+void ply_load_objects(const uint8_t *data, const size_t size, const char *filename, const struct Object *object, m3 transform, const v3 position, size_t *i_object)
+{
+	const uint8_t *end = data + size;
+	struct PLYElement elements[PLY_MAX_ELEMENTS];
+	size_t num_elements = 0;
+	bool big_endian = false;
+
+	/* Header */
+	char line[256];
+	const uint8_t *c = data;
+	bool is_header_end = false;
+	size_t line_num;
+	for (line_num = 0; !is_header_end; line_num++) {
+		const uint8_t *line_end = memchr(c, '\n', end - c);
+		error_check(line_end && (size_t)(line_end - c) < sizeof(line), "Failed to read header of mesh file [%s].", filename);
+		memcpy(line, c, line_end - c);
+		line[line_end - c] = '\0';
+		c = line_end + 1;
+
+		char *saveptr;
+		const char *keyword = strtok_r(line, " \t\r", &saveptr);
+		if (!line_num) {
+			error_check(keyword && !strcmp(keyword, "ply"), "Mesh file [%s] is not PLY.", filename);
+		} else if (!keyword || !strcmp(keyword, "comment") || !strcmp(keyword, "obj_info")) {
+			continue;
+		} else if (!strcmp(keyword, "format")) {
+			const char *format = strtok_r(NULL, " \t\r", &saveptr);
+			error_check(format && strcmp(format, "ascii"), "Mesh file [%s] does not use binary encoding.", filename);
+			big_endian = !strcmp(format, "binary_big_endian");
+		} else if (!strcmp(keyword, "element")) {
+			error_check(num_elements < PLY_MAX_ELEMENTS, "Too many elements in mesh file [%s].", filename);
+			struct PLYElement *element = &elements[num_elements++];
+			const char *name = strtok_r(NULL, " \t\r", &saveptr);
+			const char *count = strtok_r(NULL, " \t\r", &saveptr);
+			error_check(name && count, "Invalid element on line [%zu] of mesh file [%s].", line_num + 1, filename);
+			snprintf(element->name, sizeof(element->name), "%s", name);
+			element->count = strtoull(count, NULL, 10);
+			element->num_properties = 0;
+		} else if (!strcmp(keyword, "property")) {
+			error_check(num_elements && elements[num_elements - 1].num_properties < PLY_MAX_PROPERTIES, "Invalid property on line [%zu] of mesh file [%s].", line_num + 1, filename);
+			struct PLYElement *element = &elements[num_elements - 1];
+			struct PLYProperty *property = &element->properties[element->num_properties++];
+			const char *type = strtok_r(NULL, " \t\r", &saveptr);
+			error_check(type, "Invalid property on line [%zu] of mesh file [%s].", line_num + 1, filename);
+			property->is_list = !strcmp(type, "list");
+			if (property->is_list) {
+				const char *count_type = strtok_r(NULL, " \t\r", &saveptr);
+				type = strtok_r(NULL, " \t\r", &saveptr);
+				error_check(count_type && type, "Invalid property on line [%zu] of mesh file [%s].", line_num + 1, filename);
+				property->count_type = ply_parse_type(count_type, filename);
+			}
+			property->type = ply_parse_type(type, filename);
+			const char *name = strtok_r(NULL, " \t\r", &saveptr);
+			error_check(name, "Invalid property on line [%zu] of mesh file [%s].", line_num + 1, filename);
+			snprintf(property->name, sizeof(property->name), "%s", name);
+		} else if (!strcmp(keyword, "end_header")) {
+			is_header_end = true;
+		}
+	}
+
+	/* Body */
+	v3 *vertices = NULL;
+	uint32_t(*faces)[3] = NULL;
+	size_t num_vertices = 0, num_faces = 0, max_faces = 0;
+	size_t i, j, k, l;
+	for (i = 0; i < num_elements; i++) {
+		const struct PLYElement *element = &elements[i];
+		bool is_vertex = !strcmp(element->name, "vertex");
+		bool is_face = !strcmp(element->name, "face");
+		if (is_vertex) {
+			error_check(element->count <= (size_t)(end - c), "Unexpected end of mesh file [%s].", filename);
+			num_vertices = element->count;
+			vertices = safe_calloc(num_vertices, sizeof(v3));
+		}
+		for (j = 0; j < element->count; j++) {
+			for (k = 0; k < element->num_properties; k++) {
+				const struct PLYProperty *property = &element->properties[k];
+				if (!property->is_list) {
+					double value = ply_read(&c, end, property->type, big_endian, filename);
+					if (is_vertex && property->name[0] >= 'x' && property->name[0] <= 'z' && !property->name[1])
+						vertices[j][property->name[0] - 'x'] = (float)value;
+					continue;
+				}
+				size_t count = (size_t)ply_read(&c, end, property->count_type, big_endian, filename);
+				bool is_vertex_indices = is_face && (!strcmp(property->name, "vertex_indices") || !strcmp(property->name, "vertex_index"));
+				uint32_t polygon[3];
+				for (l = 0; l < count; l++) {
+					double value = ply_read(&c, end, property->type, big_endian, filename);
+					if (!is_vertex_indices)
+						continue;
+					polygon[l < 2 ? l : 2] = (uint32_t)value;
+					if (l >= 2) {
+						faces = mesh_append(faces, &max_faces, num_faces, sizeof(uint32_t[3]));
+						memcpy(faces[num_faces++], polygon, sizeof(polygon));
+						polygon[1] = polygon[2];
+					}
+				}
+			}
+		}
+	}
+	error_check(vertices, "Mesh file [%s] has no vertex element.", filename);
+
+	printf_log("Loaded [%zu] vertices and [%zu] triangles from [%s].", num_vertices, num_faces, filename);
+	mesh_indexed_to_objects(vertices, num_vertices, (const uint32_t(*)[3])faces, num_faces, filename, object, transform, position, i_object);
+	free(vertices);
+	free(faces);
 }
@@ -14,11 +14,17 @@
 
 #include "type.h"
 
+#define OBJECT_MAX_PARAMETERS 9 /* Vertices of triangle */
+
 struct Material;
 
 enum ObjectType {
 	OBJECT_SPHERE,
 	OBJECT_TRIANGLE,
+	OBJECT_QUAD,
+	OBJECT_DISC,
+	OBJECT_CYLINDER,
+	OBJECT_BOX,
 #ifdef UNBOUND_OBJECTS
 	OBJECT_PLANE,
 #endif
@@ -27,6 +33,14 @@ enum ObjectType {
 struct Ray {
 	v3 direction;
 	v3 point;
+	float time; //From 0 when the shutter opens to 1 when it closes
+};
+
+struct Motion { //Rigid motion of objects while the shutter is open, relative to their pose when it opens
+	v3 center; //Of rotation
+	v3 axis;
+	float angle;
+	v3 translation;
 };
 
 struct Object;
@@ -39,16 +53,22 @@ struct ObjectVTable {
 	void (*postinit)(struct Object *);
 	bool (*get_intersection)(const struct Object *, const struct Ray *, float *, v3);
 	bool (*intersects_in_range)(const struct Object *, const struct Ray *, float);
-	void (*delete)(struct Object *);
 	void (*get_corners)(const struct Object *, v3[2]);
 	void (*scale)(const struct Object *, const v3, const float);
 	void (*get_light_point)(const struct Object *, const v3, v3);
+	void (*get_parameters)(const struct Object *, float[OBJECT_MAX_PARAMETERS]);
+	void (*get_clipped_corners)(const struct Object *, v3[2], v3[2]); //Corners of the part of the object within a cuboid. corners[0] > corners[1] if there is none
+	void (*transform)(struct Object *, const float[OBJECT_MAX_PARAMETERS], m3, const v3); //Sets object to parameters written by get_parameters, rotated by matrix then translated
 };
 
 struct Object {
 	struct ObjectVTable const *object_data;
 	uint32_t num_lights;
+	uint32_t index; //Index of the scene's Objects entry that created this object. Shared by all triangles of a mesh
+	int32_t material_id; //Id given to the material in the scene. Materials with different ids may be interned into the same struct Material
 	float epsilon;
+	bool is_animated; //Set by animation_init, so that only parts of the BVH containing animated objects are refit
+	const struct Motion *motion; //NULL unless object moves while the shutter is open
 	struct Material *material;
 };
 
@@ -63,15 +83,41 @@ void object_init(struct Object *object, const struct Material *material, float e
 /* Creates new object and allocates memory. Requires object_init and object_data.postinit to be called after. */
 struct Object *sphere_new(const v3 position, float radius);
 struct Object *triangle_new(v3 vertices[3]);
+struct Object *quad_new(const v3 position, v3 edges[2]);
+struct Object *disc_new(const v3 position, const v3 normal, float radius);
+struct Object *cylinder_new(const v3 position, const v3 axis, float radius);
+struct Object *box_new(const v3 position, const v3 size, const v3 rotation);
 #ifdef UNBOUND_OBJECTS
 struct Object *plane_new(v3 position, v3 normal);
 #endif
 
+/* Creates new object from parameters written by object_data.get_parameters. Requires object_init and object_data.postinit to be called after. */
+struct Object *object_new(enum ObjectType object_type, const float parameters[OBJECT_MAX_PARAMETERS]);
+
+/* Rotation about the X, Y, then Z axis, followed by scaling */
+void mesh_get_transform(const v3 rot, float scale, m3 transform);
+
 void mesh_to_objects(const char *filename, struct Object *object, const v3 position, const v3 rotation, float scale, size_t *i_object);
 
 void get_objects_extents(v3 min, v3 max);
 
+/* Equivalent to object_data functions, but account for motion at ray->time. Corners bound the object's entire motion */
+bool object_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal);
+bool object_intersects_in_range(const struct Object *object, const struct Ray *ray, float min_distance);
+void object_get_corners(const struct Object *object, v3 corners[2]);
+void object_get_clipped_corners(const struct Object *object, v3 bounds[2], v3 corners[2]);
+
+/* Intersection kernels */
+bool line_intersects_sphere(const v3 sphere_position, float sphere_radius, const v3 line_position, const v3 line_vector, float epsilon, float *distance);
+bool line_intersects_triangle(v3 vertices[3], const v3 line_position, const v3 line_vector, float *distance);
+#ifdef UNBOUND_OBJECTS
+bool plane_get_intersection(const struct Object *object, const struct Ray *ray, float *distance, v3 normal);
+#endif
+
 #ifdef UNBOUND_OBJECTS
+/* Requires bounded objects to be loaded. Rays which remain near them and viewpoint skip planes which are farther away */
+void unbound_objects_init(const v3 viewpoint);
+bool unbound_objects_contain(const struct Ray *ray, float distance);
 void unbound_objects_get_closest_intersection(const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance);
 bool unbound_objects_is_light_blocked(const struct Ray *ray, const float distance, v3 light_intensity, const struct Object *emittant_object);
 #endif
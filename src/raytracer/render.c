@@ -12,23 +12,33 @@
 #include "render.h"
 
 #include <float.h>
+#include <inttypes.h>
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "accel.h"
+#include "animation.h"
 #include "argv.h"
 #include "calc.h"
 #include "camera.h"
+#include "error.h"
 #include "image.h"
 #include "material.h"
 #include "mem.h"
 #include "object.h"
+#include "stats.h"
 #include "system.h"
+#include "trace.h"
 
 #ifdef MULTITHREADING
 #include <omp.h>
 #endif
 
+#define ADAPTIVE_SAMPLES 4 //Taken in every pixel before deciding whether it is an edge which needs the remaining samples
+
 enum ReflectionModel {
 	REFLECTION_PHONG,
 	REFLECTION_BLINN,
@@ -45,9 +55,56 @@ enum LightAttenuation {
 	LIGHT_ATTENUATION_SQUARE,
 };
 
+enum Filter { //Reconstruction filter which samples within a pixel are splatted into image with
+	FILTER_NONE, //Rays are cast through pixel centers
+	FILTER_BOX,
+	FILTER_TENT,
+	FILTER_MITCHELL,
+	FILTER_BLACKMAN_HARRIS,
+};
+
+struct FirstHit { //Surface data of a primary ray's intersection, written to the auxiliary image buffers
+	struct Object *object;
+	v3 normal;
+	v3 albedo;
+};
+
+struct Packet { //Primary rays through adjacent pixels of a row, and their closest intersections
+	struct Ray rays[ACCEL_MAX_PACKET_RAYS];
+	struct Object *objects[ACCEL_MAX_PACKET_RAYS];
+	v3 normals[ACCEL_MAX_PACKET_RAYS];
+	float distances[ACCEL_MAX_PACKET_RAYS];
+};
+
+struct SamplePosition { //Position of a sample in the image, when samples are splatted with a filter
+	int32_t pixel[2];
+	v2 offset; //From corner of pixel, in [0, 1). Kept apart from pixel so that rounding cannot move samples onto the edges of pixels
+};
+
+struct DeferredRay { //Path tracing ray which is cast once the rays of its row are sorted
+	struct Ray ray;
+	v3 kr; //Contribution to color of pixel
+	uint32_t pixel_index;
+	struct SamplePosition sample_position;
+};
+
 void get_closest_intersection(const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance);
+void packet_cast(struct Packet *packet, const v3 pixel_position, uint32_t num_rays);
 bool is_light_blocked(const struct Ray *ray, float distance, v3 light_intensity, const struct Object *emittant_object);
-float cast_ray(const struct Ray *ray, const v3 kr, v3 color, uint32_t bounce_count, struct Object *inside_object);
+float cast_ray(const struct Ray *ray, const v3 kr, v3 color, uint32_t bounce_count, struct Object *inside_object, struct FirstHit *first_hit);
+float cast_primary_ray(const struct Ray *ray, const struct Packet *packet, uint32_t packet_index, v3 color, struct FirstHit *first_hit);
+float shade(const struct Ray *ray, struct Object *object, const v3 normal, float min_distance, const v3 kr, v3 color, uint32_t remaining_bounces, struct Object *inside_object, struct FirstHit *first_hit);
+void store_first_hit(size_t pixel_index, const struct FirstHit *first_hit, uint32_t num_rays);
+void offset_ray_origin(const v3 point, const v3 normal, bool front, v3 origin);
+void sample_lens(const v3 direction, struct Ray *ray);
+float radical_inverse(uint32_t index, uint32_t base);
+void sample_pixel(const v3 pixel_position, uint32_t col, uint32_t row, uint32_t sample, const v2 rotation, v3 direction, struct SamplePosition *sample_position);
+float filter_evaluate(float offset);
+void splat(const v3 color, const struct SamplePosition *position, bool add_weight);
+float get_attenuation(float distance);
+void defer_ray(const struct Ray *ray, const v3 kr);
+int deferred_ray_compare(const void *p1, const void *p2);
+void cast_deferred_rays(void);
 
 static float light_attenuation_offset = 1.f;
 v3 global_ambient_light_intensity = { 0 };
@@ -56,7 +113,24 @@ static float minimum_light_intensity_sqr = .01f * .01f;
 static enum ReflectionModel reflection_model = REFLECTION_PHONG;
 static enum GlobalIlluminationModel global_illumination_model = GLOBAL_ILLUMINATION_AMBIENT;
 static size_t samples_per_pixel = 1;
+static uint32_t primary_samples_per_pixel = 1; //Cast at different times while the shutter is open, through different points on the lens, and through different points in the pixel. Path tracing casts the remaining samples from each first hit
 static enum LightAttenuation light_attenuation = LIGHT_ATTENUATION_SQUARE;
+static _Thread_local uint32_t ray_count; //Rays cast by the current thread, including shadow rays
+static uint32_t frame_seed; //Added to the pixel index to seed each pixel's random numbers
+static uint32_t packet_size = 16; //Primary rays through adjacent pixels of a row which are traced through BVH together
+static bool sort_rays = false;
+static v3 sort_offset, sort_scale; //Map bounds of objects to unit cube, in which origins of deferred rays are divided into cells by their Morton codes
+static _Thread_local uint32_t current_pixel_index;
+static _Thread_local struct SamplePosition current_sample_position;
+static _Thread_local struct DeferredRay *deferred_rays;
+static _Thread_local uint64_t *deferred_ray_keys; //Sort key in upper 32 bits, index of ray in lower 32 bits
+static _Thread_local size_t num_deferred_rays;
+static _Thread_local size_t max_deferred_rays;
+static enum Filter filter = FILTER_NONE;
+static float filter_radius; //In pixels
+static bool adaptive_sampling = false;
+static float adaptive_threshold; //Difference of color channel between the first samples of a pixel above which it is an edge
+static float *filter_weights; //Sum of weights of samples splatted into each pixel
 
 void render_init(void)
 {
@@ -113,14 +187,90 @@ void render_init(void)
 	idx = argv_check_with_args("-o", 1);
 	if (idx)
 		light_attenuation_offset = atof(myargv[idx + 1]);
+
+	idx = argv_check_with_args("--packet", 1);
+	if (idx) {
+		packet_size = abs(atoi(myargv[idx + 1]));
+		error_check(packet_size && packet_size <= ACCEL_MAX_PACKET_RAYS, "Expected packet size [%u] from [1] to [%u].", packet_size, ACCEL_MAX_PACKET_RAYS);
+	}
+
+	sort_rays = argv_check("--sort-rays") && global_illumination_model == GLOBAL_ILLUMINATION_PATH_TRACING;
+
+	idx = argv_check_with_args("--filter", 1);
+	if (idx)
+		switch (hash_myargv[idx + 1]) {
+		case 193415088: //box
+			filter = FILTER_BOX;
+			filter_radius = .5f;
+			break;
+		case 2087956942: //tent
+			filter = FILTER_TENT;
+			filter_radius = 1.f;
+			break;
+		case 4029970875u: //mitchell
+			filter = FILTER_MITCHELL;
+			filter_radius = 2.f;
+			break;
+		case 2562098046u: //blackman-harris
+			filter = FILTER_BLACKMAN_HARRIS;
+			filter_radius = 1.5f;
+			break;
+		}
+
+	//Path tracing needs every sample of every pixel, and motion blur is stratified over all of them
+	idx = argv_check_with_args("--adaptive", 1);
+	if (idx && filter != FILTER_NONE && global_illumination_model == GLOBAL_ILLUMINATION_AMBIENT && shutter == 0.f) {
+		adaptive_sampling = true;
+		adaptive_threshold = atof(myargv[idx + 1]);
+	}
+
+	if ((shutter > 0.f || camera.aperture > 0.f || filter != FILTER_NONE) && samples_per_pixel > 1) {
+		primary_samples_per_pixel = samples_per_pixel;
+		printf_log("Casting %u primary rays per pixel%s.", primary_samples_per_pixel, adaptive_sampling ? " at edges" : "");
+	}
+
+#ifdef UNBOUND_OBJECTS
+	if (num_unbound_objects)
+		unbound_objects_init(camera.position);
+#endif
+
+	if (argv_check("--deterministic"))
+		printf_log("Using deterministic seeds.");
+	else
+		frame_seed = (uint32_t)time(NULL);
 }
 
 void get_closest_intersection(const struct Ray *ray, struct Object **closest_object, v3 closest_normal, float *closest_distance)
 {
+	accel_get_closest_intersection(ray, closest_object, closest_normal, closest_distance);
 #ifdef UNBOUND_OBJECTS
 	unbound_objects_get_closest_intersection(ray, closest_object, closest_normal, closest_distance);
 #endif
-	accel_get_closest_intersection(ray, closest_object, closest_normal, closest_distance);
+}
+
+//Casts rays through num_rays pixels starting at pixel_position, and finds their closest intersections
+void packet_cast(struct Packet *packet, const v3 pixel_position, const uint32_t num_rays)
+{
+	v3 position;
+	assign3(position, pixel_position);
+	uint32_t i;
+	for (i = 0; i < num_rays; i++) {
+		if (i)
+			add3v(position, image.vectors[X], position);
+		struct Ray *ray = &packet->rays[i];
+		assign3(ray->point, camera.position);
+		sub3v(position, camera.position, ray->direction);
+		norm3(ray->direction);
+		ray->time = 0.f;
+		packet->objects[i] = NULL;
+		packet->distances[i] = FLT_MAX;
+	}
+
+	accel_get_closest_intersections(packet->rays, num_rays, packet->objects, packet->normals, packet->distances);
+#ifdef UNBOUND_OBJECTS
+	for (i = 0; i < num_rays; i++)
+		unbound_objects_get_closest_intersection(&packet->rays[i], &packet->objects[i], packet->normals[i], &packet->distances[i]);
+#endif
 }
 
 bool is_light_blocked(const struct Ray *ray, const float distance, v3 light_intensity, const struct Object *emittant_object)
@@ -133,14 +283,16 @@ bool is_light_blocked(const struct Ray *ray, const float distance, v3 light_inte
 #endif
 }
 
-float cast_ray(const struct Ray *ray, const v3 kr, v3 color, const uint32_t remaining_bounces, struct Object *inside_object)
+float cast_ray(const struct Ray *ray, const v3 kr, v3 color, const uint32_t remaining_bounces, struct Object *inside_object, struct FirstHit *first_hit)
 {
 	struct Object *object = NULL;
 	v3 normal;
 	float min_distance;
 
+	ray_count++;
+
 	/* get ray intersection */
-	if (inside_object && inside_object->object_data->get_intersection(inside_object, ray, &min_distance, normal)) {
+	if (inside_object && (STAT_INC(STAT_PRIMITIVE_TESTS), true) && object_get_intersection(inside_object, ray, &min_distance, normal)) {
 		object = inside_object;
 	} else {
 		min_distance = FLT_MAX;
@@ -149,23 +301,52 @@ float cast_ray(const struct Ray *ray, const v3 kr, v3 color, const uint32_t rema
 
 	if (!object)
 		return 0.f;
+	return shade(ray, object, normal, min_distance, kr, color, remaining_bounces, inside_object, first_hit);
+}
 
-	//Ray originating at point of intersection
-	struct Ray outgoing_ray;
-	mul3s(ray->direction, min_distance, outgoing_ray.point);
-	add3v(outgoing_ray.point, ray->point, outgoing_ray.point);
+//Casts primary ray, whose closest intersection is in packet at packet_index unless packet is NULL
+float cast_primary_ray(const struct Ray *ray, const struct Packet *packet, const uint32_t packet_index, v3 color, struct FirstHit *first_hit)
+{
+	const v3 kr = { 1.f, 1.f, 1.f };
+	if (!packet)
+		return cast_ray(ray, kr, color, max_bounces, NULL, first_hit);
+
+	ray_count++;
+	struct Object *object = packet->objects[packet_index];
+	if (!object)
+		return 0.f;
+	return shade(ray, object, packet->normals[packet_index], packet->distances[packet_index], kr, color, max_bounces, NULL, first_hit);
+}
+
+//Lighting of ray's intersection with object
+float shade(const struct Ray *ray, struct Object *object, const v3 normal, const float min_distance, const v3 kr, v3 color, const uint32_t remaining_bounces, struct Object *inside_object, struct FirstHit *first_hit)
+{
+	v3 point;
+	mul3s(ray->direction, min_distance, point);
+	add3v(point, ray->point, point);
 
 	//LIGHTING MODEL
 	v3 obj_color;
 
 	struct Material *material = object->material;
 
+	if (first_hit) {
+		first_hit->object = object;
+		assign3(first_hit->normal, normal);
+		material->texture->get_color(material->texture, point, first_hit->albedo);
+	}
+
 	//emittance
 	assign3(obj_color, material->ke);
 
 	float b = dot3(normal, ray->direction);
 	bool is_outside = signbit(b);
 
+	//Ray originating just off the surface on the side of the incoming ray, so it cannot hit the surface at its origin
+	struct Ray outgoing_ray;
+	outgoing_ray.time = ray->time;
+	offset_ray_origin(point, normal, is_outside, outgoing_ray.point);
+
 	size_t i, j;
 	for (i = 0; i < num_emittant_objects; i++) {
 		struct Object *emittant_object = emittant_objects[i];
@@ -175,7 +356,7 @@ float cast_ray(const struct Ray *ray, const v3 kr, v3 color, const uint32_t rema
 		mul3s(emittant_object->material->ke, 1.f / emittant_object->num_lights, light_intensity);
 		for (j = 0; j < emittant_object->num_lights; j++) {
 			v3 light_point, incoming_light_intensity;
-			emittant_object->object_data->get_light_point(emittant_object, outgoing_ray.point, light_point);
+			emittant_object->object_data->get_light_point(emittant_object, point, light_point);
 			assign3(incoming_light_intensity, light_intensity);
 
 			sub3v(light_point, outgoing_ray.point, outgoing_ray.direction);
@@ -184,7 +365,9 @@ float cast_ray(const struct Ray *ray, const v3 kr, v3 color, const uint32_t rema
 
 			float a = dot3(outgoing_ray.direction, normal);
 
+			ray_count += is_outside;
 			if (is_outside
+				&& (STAT_INC(STAT_SHADOW_RAYS), true)
 				&& !is_light_blocked(&outgoing_ray, light_distance, incoming_light_intensity, emittant_object)) {
 				v3 distance;
 				sub3v(light_point, outgoing_ray.point, distance);
@@ -200,7 +383,7 @@ float cast_ray(const struct Ray *ray, const v3 kr, v3 color, const uint32_t rema
 				}
 
 				v3 diffuse;
-				material->texture->get_color(material->texture, outgoing_ray.point, diffuse);
+				material->texture->get_color(material->texture, point, diffuse);
 				mul3v(diffuse, incoming_light_intensity, diffuse);
 				mul3s(diffuse, fmaxf(0., a), diffuse);
 
@@ -270,7 +453,7 @@ float cast_ray(const struct Ray *ray, const v3 kr, v3 color, const uint32_t rema
 			v3 delta = { 1.f, 1.f, 1.f };
 			size_t num_samples;
 			if (remaining_bounces == max_bounces) {
-				num_samples = samples_per_pixel;
+				num_samples = samples_per_pixel / primary_samples_per_pixel;
 				mul3s(delta, 1.f / (float)num_samples, delta);
 			} else {
 				num_samples = 1;
@@ -282,23 +465,21 @@ float cast_ray(const struct Ray *ray, const v3 kr, v3 color, const uint32_t rema
 				float azimuth = rand_flt() * PI;
 				mulmv(rotation_matrix, (v3)SPHERICAL_TO_CARTESIAN(1, inclination, azimuth), outgoing_ray.direction);
 				mul3s(delta, dot3(normal, outgoing_ray.direction), light_mul);
-				cast_ray(&outgoing_ray, light_mul, obj_color, 0, NULL);
+				STAT_INC(STAT_SECONDARY_RAYS);
+				if (sort_rays) {
+					mul3v(light_mul, kr, light_mul);
+					mul3s(light_mul, get_attenuation(min_distance), light_mul);
+					defer_ray(&outgoing_ray, light_mul);
+				} else {
+					cast_ray(&outgoing_ray, light_mul, obj_color, 0, NULL, NULL);
+				}
 			}
 		}
 		break;
 	}
 
 	mul3v(obj_color, kr, obj_color);
-	switch (light_attenuation) {
-	case LIGHT_ATTENUATION_NONE:
-		break;
-	case LIGHT_ATTENUATION_LINEAR:
-		mul3s(obj_color, 1.f / (light_attenuation_offset + min_distance), obj_color);
-		break;
-	case LIGHT_ATTENUATION_SQUARE:
-		mul3s(obj_color, 1.f / sqr(light_attenuation_offset + min_distance), obj_color);
-		break;
-	}
+	mul3s(obj_color, get_attenuation(min_distance), obj_color);
 	add3v(color, obj_color, color);
 
 	if (!remaining_bounces)
@@ -312,7 +493,8 @@ float cast_ray(const struct Ray *ray, const v3 kr, v3 color, const uint32_t rema
 		if (minimum_light_intensity_sqr < magsqr3(reflected_kr)) {
 			mul3s(normal, 2 * b, outgoing_ray.direction);
 			sub3v(ray->direction, outgoing_ray.direction, outgoing_ray.direction);
-			cast_ray(&outgoing_ray, reflected_kr, color, remaining_bounces - 1, NULL);
+			STAT_INC(STAT_SECONDARY_RAYS);
+			cast_ray(&outgoing_ray, reflected_kr, color, remaining_bounces - 1, NULL, NULL);
 		}
 	}
 
@@ -335,34 +517,364 @@ float cast_ray(const struct Ray *ray, const v3 kr, v3 color, const uint32_t rema
 			mul3s(f, sinf(delta_angle), h);
 			add3v(g, h, outgoing_ray.direction);
 			norm3(outgoing_ray.direction);
-			cast_ray(&outgoing_ray, refracted_kt, color, remaining_bounces - 1, object);
+			offset_ray_origin(point, normal, !is_outside, outgoing_ray.point);
+			STAT_INC(STAT_SECONDARY_RAYS);
+			cast_ray(&outgoing_ray, refracted_kt, color, remaining_bounces - 1, object, NULL);
 		}
 	}
 
 	return min_distance;
 }
 
+//Offsets point along normal if front, or against it otherwise, by enough to exceed its rounding error (Wächter, Binder)
+void offset_ray_origin(const v3 point, const v3 normal, const bool front, v3 origin)
+{
+	const float int_scale = front ? 256.f : -256.f;
+	const float float_scale = front ? 1.f / 65536.f : -1.f / 65536.f;
+	size_t i;
+	for (i = 0; i < 3; i++) {
+		if (fabsf(point[i]) < 1.f / 32.f) { //Units in the last place are too small near the origin
+			origin[i] = point[i] + float_scale * normal[i];
+			continue;
+		}
+		union {
+			float f;
+			int32_t i;
+		} offset_point = { .f = point[i] };
+		int32_t offset = (int32_t)(int_scale * normal[i]);
+		offset_point.i += signbit(point[i]) ? -offset : offset;
+		origin[i] = offset_point.f;
+	}
+}
+
+//Multiplier of light which travelled distance
+float get_attenuation(const float distance)
+{
+	switch (light_attenuation) {
+	case LIGHT_ATTENUATION_NONE:
+		break;
+	case LIGHT_ATTENUATION_LINEAR:
+		return 1.f / (light_attenuation_offset + distance);
+	case LIGHT_ATTENUATION_SQUARE:
+		return 1.f / sqr(light_attenuation_offset + distance);
+	}
+	return 1.f;
+}
+
+void ray_sort_init(void)
+{
+	v3 max;
+	get_objects_extents(sort_offset, max);
+	size_t i;
+	for (i = 0; i < 3; i++)
+		sort_scale[i] = 1.f / fmaxf(max[i] - sort_offset[i], FLT_MIN);
+}
+
+//Direction octant, followed by Morton code of origin in a grid of 512^3 cells
+uint32_t ray_sort_key(const struct Ray *ray)
+{
+	v3 cell;
+	sub3v(ray->point, sort_offset, cell);
+	mul3v(cell, sort_scale, cell);
+	clamp3(cell, (v3){ 0.f, 0.f, 0.f }, (v3){ 1.f, 1.f, 1.f }, cell);
+	uint32_t octant = (ray->direction[X] < 0.f) | (ray->direction[Y] < 0.f) << 1 | (ray->direction[Z] < 0.f) << 2;
+	return octant << 27 | morton_code(cell) >> 3;
+}
+
+//Rays are cast in order of ray_sort_key, so that consecutive rays traverse the same parts of the BVH
+void defer_ray(const struct Ray *ray, const v3 kr)
+{
+	if (num_deferred_rays == max_deferred_rays) {
+		max_deferred_rays = max_deferred_rays ? max_deferred_rays * 2 : 1024;
+		deferred_rays = safe_realloc(deferred_rays, sizeof(struct DeferredRay) * max_deferred_rays);
+		deferred_ray_keys = safe_realloc(deferred_ray_keys, sizeof(uint64_t) * max_deferred_rays);
+	}
+	struct DeferredRay *deferred_ray = &deferred_rays[num_deferred_rays];
+
+	deferred_ray_keys[num_deferred_rays] = (uint64_t)ray_sort_key(ray) << 32 | num_deferred_rays;
+	deferred_ray->ray = *ray;
+	mul3s(kr, filter == FILTER_NONE ? 1.f / primary_samples_per_pixel : 1.f, deferred_ray->kr); //Filtered samples are normalized by their weights
+	deferred_ray->pixel_index = current_pixel_index;
+	deferred_ray->sample_position = current_sample_position;
+	num_deferred_rays++;
+}
+
+int deferred_ray_compare(const void *p1, const void *p2)
+{
+	const uint64_t key1 = *(const uint64_t *)p1, key2 = *(const uint64_t *)p2;
+	return (key1 > key2) - (key1 < key2);
+}
+
+//Casts rays deferred by the calling thread, and adds their contributions to their pixels
+void cast_deferred_rays(void)
+{
+	qsort(deferred_ray_keys, num_deferred_rays, sizeof(uint64_t), &deferred_ray_compare);
+	const bool heatmap = image.cost_buffer;
+	const bool aov = image.ray_count_buffer;
+	size_t i;
+	for (i = 0; i < num_deferred_rays; i++) {
+		const struct DeferredRay *deferred_ray = &deferred_rays[(uint32_t)deferred_ray_keys[i]];
+		uint32_t first_cost = accel_traversal_cost, first_ray = ray_count;
+		if (filter == FILTER_NONE) {
+			cast_ray(&deferred_ray->ray, deferred_ray->kr, image.raster[deferred_ray->pixel_index], 0, NULL, NULL);
+		} else {
+			v3 color = { 0.f, 0.f, 0.f };
+			cast_ray(&deferred_ray->ray, deferred_ray->kr, color, 0, NULL, NULL);
+			splat(color, &deferred_ray->sample_position, false);
+		}
+		if (unlikely(heatmap))
+			image.cost_buffer[deferred_ray->pixel_index] += accel_traversal_cost - first_cost;
+		if (unlikely(aov))
+			image.ray_count_buffer[deferred_ray->pixel_index] += ray_count - first_ray;
+	}
+	num_deferred_rays = 0;
+}
+
+//Moves origin of ray to a random point on the lens, and aims it at the point where the pinhole ray in direction crosses the plane in focus
+void sample_lens(const v3 direction, struct Ray *ray)
+{
+	v3 focus_point, offset_x, offset_y, lens_offset;
+	mul3s(direction, camera.focus_distance / dot3(direction, camera.vectors[Z]), focus_point);
+	float radius = .5f * camera.aperture * sqrtf(rand_flt());
+	float angle = 2.f * PI * rand_flt();
+	mul3s(camera.vectors[X], radius * cosf(angle), offset_x);
+	mul3s(camera.vectors[Y], radius * sinf(angle), offset_y);
+	add3v(offset_x, offset_y, lens_offset);
+	add3v(camera.position, lens_offset, ray->point);
+	sub3v(focus_point, lens_offset, ray->direction);
+	norm3(ray->direction);
+}
+
+//Van der Corput sequence in base. Any number of consecutive samples starting from 0 are evenly spread
+float radical_inverse(uint32_t index, const uint32_t base)
+{
+	const float inverse_base = 1.f / base;
+	float digit_weight = inverse_base, inverse = 0.f;
+	while (index) {
+		inverse += (index % base) * digit_weight;
+		index /= base;
+		digit_weight *= inverse_base;
+	}
+	return inverse;
+}
+
+//Halton sequence, randomly rotated in each pixel, so that the first samples of a pixel are already stratified
+void sample_pixel(const v3 pixel_position, const uint32_t col, const uint32_t row, const uint32_t sample, const v2 rotation, v3 direction, struct SamplePosition *sample_position)
+{
+	v2 offset = { radical_inverse(sample, 2) + rotation[X], radical_inverse(sample, 3) + rotation[Y] };
+	size_t i;
+	for (i = 0; i < 2; i++) {
+		if (offset[i] >= 1.f)
+			offset[i] -= 1.f;
+		sample_position->offset[i] = offset[i];
+	}
+	sample_position->pixel[X] = (int32_t)col;
+	sample_position->pixel[Y] = (int32_t)row;
+
+	v3 offset_x, offset_y;
+	mul3s(image.vectors[X], offset[X] - .5f, offset_x);
+	mul3s(image.vectors[Y], offset[Y] - .5f, offset_y);
+	add3v3(pixel_position, offset_x, offset_y, direction);
+	sub3v(direction, camera.position, direction);
+	norm3(direction);
+}
+
+//Separable filter at offset from center of pixel, in pixels, which is less than filter_radius
+float filter_evaluate(const float offset)
+{
+	const float x = fabsf(offset);
+	switch (filter) {
+	case FILTER_NONE:
+	case FILTER_BOX:
+		return 1.f;
+	case FILTER_TENT:
+		return 1.f - x;
+	case FILTER_MITCHELL: //B = C = 1/3
+		if (x < 1.f)
+			return (7.f * x * x * x - 12.f * x * x + 16.f / 3.f) / 6.f;
+		return (-7.f / 3.f * x * x * x + 12.f * x * x - 20.f * x + 32.f / 3.f) / 6.f;
+	case FILTER_BLACKMAN_HARRIS: {
+		const float t = 2.f * PI * (offset / (2.f * filter_radius) + .5f);
+		return .35875f - .48829f * cosf(t) + .14128f * cosf(2.f * t) - .01168f * cosf(3.f * t);
+	}
+	}
+	return 0.f;
+}
+
+//Adds color of sample to pixels whose centers are within filter_radius of it
+//Support is half-open, so that the box filter only splats into the pixel containing the sample
+void splat(const v3 color, const struct SamplePosition *position, const bool add_weight)
+{
+	int32_t min[2], max[2];
+	v2 center_offset; //Of pixel centers from sample, relative to pixel containing sample
+	size_t i;
+	for (i = 0; i < 2; i++) {
+		center_offset[i] = .5f - position->offset[i];
+		min[i] = MAX(0, position->pixel[i] + (int32_t)floorf(-center_offset[i] - filter_radius) + 1);
+		max[i] = MIN((int32_t)image.resolution[i] - 1, position->pixel[i] + (int32_t)floorf(filter_radius - center_offset[i]));
+	}
+	int32_t x, y;
+	for (y = min[Y]; y <= max[Y]; y++) {
+		const float weight_y = filter_evaluate(y - position->pixel[Y] + center_offset[Y]);
+		for (x = min[X]; x <= max[X]; x++) {
+			const float weight = weight_y * filter_evaluate(x - position->pixel[X] + center_offset[X]);
+			const size_t pixel_index = (size_t)y * image.resolution[X] + x;
+			v3 weighted_color;
+			mul3s(color, weight, weighted_color);
+			add3v(image.raster[pixel_index], weighted_color, image.raster[pixel_index]);
+			if (add_weight)
+				filter_weights[pixel_index] += weight;
+		}
+	}
+}
+
+void store_first_hit(const size_t pixel_index, const struct FirstHit *first_hit, const uint32_t num_rays)
+{
+	struct Object *object = first_hit->object;
+	assign3(image.normal_buffer[pixel_index], first_hit->normal);
+	assign3(image.albedo_buffer[pixel_index], first_hit->albedo);
+	image.material_buffer[pixel_index] = object ? object->material_id : -1;
+	image.object_buffer[pixel_index] = object ? (int32_t)object->index : -1;
+	image.ray_count_buffer[pixel_index] = num_rays;
+}
+
 void render(void)
 {
 	printf_log("Commencing raytracing.");
-	v3 kr = { 1.f, 1.f, 1.f };
+	const bool aov = image.normal_buffer;
+	const bool heatmap = image.cost_buffer;
+	const bool motion_blur = shutter > 0.f;
+	const bool depth_of_field = camera.aperture > 0.f;
+	//Heatmap is of each pixel's traversal, and primary rays cast at different times or through different points on the lens or pixel are not coherent
+	const uint32_t num_packet_rays = (heatmap || motion_blur || primary_samples_per_pixel > 1 || depth_of_field || filter != FILTER_NONE) ? 1 : packet_size;
+	//Samples are splatted into nearby rows, so rows which share pixels that they splat into are rendered in different phases. This keeps output independent of thread count
+	//Box filter only splats into the pixel containing each sample, so its rows never share pixels
+	const uint32_t num_phases = filter_radius > .5f ? 2 * (uint32_t)ceilf(filter_radius) + 1 : 1;
+	const float primary_sample_weight = 1.f / primary_samples_per_pixel;
+	const double start_time = trace_time();
+	uint64_t total_ray_count = 0;
+	memset(image.raster, 0, image.pixels * sizeof(v3)); //Colors are accumulated into raster
+	if (sort_rays)
+		ray_sort_init();
+	if (filter != FILTER_NONE)
+		filter_weights = safe_calloc(image.pixels, sizeof(float));
+#ifdef MULTITHREADING
+#pragma omp parallel
+#endif
+	{
+		ray_count = 0;
+		for (uint32_t phase = 0; phase < num_phases; phase++) {
 #ifdef MULTITHREADING
-#pragma omp parallel for
+#pragma omp for
 #endif
-	for (uint32_t row = 0; row < image.resolution[Y]; row++) {
-		v3 pixel_position;
-		mul3s(image.vectors[Y], row, pixel_position);
-		add3v(pixel_position, image.corner, pixel_position);
-		struct Ray ray;
-		assign3(ray.point, camera.position);
-		uint32_t pixel_index = image.resolution[X] * row;
-		uint32_t col;
-		for (col = 0; col < image.resolution[X]; col++) {
-			add3v(pixel_position, image.vectors[X], pixel_position);
-			sub3v(pixel_position, camera.position, ray.direction);
-			norm3(ray.direction);
-			image.z_buffer[pixel_index] = cast_ray(&ray, kr, image.raster[pixel_index], max_bounces, NULL);
-			pixel_index++;
+			for (uint32_t row = phase; row < image.resolution[Y]; row += num_phases) {
+				double t = trace_time();
+				v3 pixel_position;
+				mul3s(image.vectors[Y], row, pixel_position);
+				add3v(pixel_position, image.corner, pixel_position);
+				struct Ray ray;
+				assign3(ray.point, camera.position);
+				ray.time = 0.f;
+				struct Packet packet;
+				uint32_t pixel_index = image.resolution[X] * row;
+				uint32_t col;
+				for (col = 0; col < image.resolution[X]; col++) {
+					add3v(pixel_position, image.vectors[X], pixel_position);
+					v3 direction;
+					sub3v(pixel_position, camera.position, direction);
+					norm3(direction);
+					assign3(ray.direction, direction);
+					const uint32_t packet_index = col % num_packet_rays;
+					if (num_packet_rays > 1 && !packet_index)
+						packet_cast(&packet, pixel_position, MIN(num_packet_rays, image.resolution[X] - col));
+					rand_seed(frame_seed + pixel_index);
+					current_pixel_index = pixel_index;
+					uint32_t first_cost = accel_traversal_cost;
+					v2 rotation;
+					if (filter != FILTER_NONE) {
+						rotation[X] = rand_flt();
+						rotation[Y] = rand_flt();
+					}
+					v3 min_color = { FLT_MAX, FLT_MAX, FLT_MAX }, max_color = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+					uint32_t sample;
+					for (sample = 0; sample < primary_samples_per_pixel; sample++) {
+						STAT_INC(STAT_PRIMARY_RAYS);
+						if (filter != FILTER_NONE) {
+							sample_pixel(pixel_position, col, row, sample, rotation, direction, &current_sample_position);
+							assign3(ray.direction, direction);
+						}
+						if (motion_blur) //Stratified over the shutter interval
+							ray.time = (sample + rand_flt()) * primary_sample_weight;
+						if (depth_of_field)
+							sample_lens(direction, &ray);
+						v3 color = { 0.f, 0.f, 0.f };
+						if (unlikely(aov) && !sample) { //Auxiliary buffers and z buffer are of the first sample
+							struct FirstHit first_hit = { 0 };
+							uint32_t first_ray = ray_count;
+							image.z_buffer[pixel_index] = cast_primary_ray(&ray, num_packet_rays > 1 ? &packet : NULL, packet_index, color, &first_hit);
+							store_first_hit(pixel_index, &first_hit, ray_count - first_ray);
+						} else {
+							float distance = cast_primary_ray(&ray, num_packet_rays > 1 ? &packet : NULL, packet_index, color, NULL);
+							if (!sample)
+								image.z_buffer[pixel_index] = distance;
+						}
+						if (filter == FILTER_NONE) {
+							mul3s(color, primary_sample_weight, color);
+							add3v(image.raster[pixel_index], color, image.raster[pixel_index]);
+							continue;
+						}
+						splat(color, &current_sample_position, true);
+						if (adaptive_sampling && sample < ADAPTIVE_SAMPLES) {
+							size_t i;
+							for (i = 0; i < 3; i++) {
+								min_color[i] = fminf(min_color[i], color[i]);
+								max_color[i] = fmaxf(max_color[i], color[i]);
+							}
+							if (sample == ADAPTIVE_SAMPLES - 1 && max_color[0] - min_color[0] <= adaptive_threshold
+								&& max_color[1] - min_color[1] <= adaptive_threshold && max_color[2] - min_color[2] <= adaptive_threshold)
+								break; //Not an edge
+						}
+					}
+					if (unlikely(heatmap))
+						image.cost_buffer[pixel_index] = accel_traversal_cost - first_cost;
+					pixel_index++;
+				}
+				if (sort_rays)
+					cast_deferred_rays();
+				trace_event("Row", NULL, t);
+			}
+		}
+#ifdef MULTITHREADING
+#pragma omp atomic
+#endif
+		total_ray_count += ray_count;
+		free(deferred_rays);
+		free(deferred_ray_keys);
+		deferred_rays = NULL;
+		deferred_ray_keys = NULL;
+		max_deferred_rays = 0;
+#ifdef STATISTICS
+		stats_merge();
+#endif
+	}
+	if (filter != FILTER_NONE) {
+		size_t i, j;
+		for (i = 0; i < image.pixels; i++) {
+			if (filter_weights[i] > 0.f)
+				mul3s(image.raster[i], 1.f / filter_weights[i], image.raster[i]);
+			for (j = 0; j < 3; j++) //Negative lobes of the Mitchell filter ring at edges
+				image.raster[i][j] = fmaxf(image.raster[i][j], 0.f);
 		}
+		free(filter_weights);
+		filter_weights = NULL;
 	}
+	const double render_time = trace_time() - start_time;
+	printf_log("Cast %" PRIu64 " rays in %.3fs.", total_ray_count, render_time);
+
+	char detail[32];
+	snprintf(detail, sizeof(detail), "%" PRIu64 " rays", total_ray_count);
+	trace_event("Render", detail, start_time);
+#ifdef STATISTICS
+	stats_print(render_time);
+#endif
 }
@@ -14,9 +14,16 @@
 
 #include "type.h"
 
+struct Ray;
+
 void render_init(void);
 void render(void);
 
+/* Requires objects to be loaded. Bounds origins of rays which are sorted */
+void ray_sort_init(void);
+/* Rays with equal keys have the same direction octant and nearby origins */
+uint32_t ray_sort_key(const struct Ray *ray);
+
 extern v3 global_ambient_light_intensity;
 
 #endif /* __RENDER_H__ */
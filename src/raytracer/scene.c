@@ -6,13 +6,20 @@
  * Full license information available in the project LICENSE file.
  *
  * DESCRIPTION:
- *   Loading camera, image, objects, materials from json scene file
+ *   Loading camera, image, objects, materials from json or binary scene file
  **/
 
+#define _POSIX_C_SOURCE 200809L /* mmap */
+
 #include "scene.h"
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "animation.h"
 #include "argv.h"
 #include "calc.h"
 #include "camera.h"
@@ -40,20 +47,74 @@
 		error_check(cJSON_GetArraySize(var) == len, SCENE_ERROR_MSG("Expected token [" token "] of length [%d]"), len, scene_filename); \
 	} while (0)
 
+#define SCENE_MAGIC "RTSCENE"
+#define SCENE_VERSION 4
+#define SCENE_BYTE_ORDER 0x01020304u
+#define SCENE_OBJECT_PLANE 6 /* OBJECT_PLANE, which only exists if UNBOUND_OBJECTS is defined */
+
+/* Binary scene: SceneHeader, SceneMaterial[num_materials], SceneObject[num_objects].
+ * Meshes are stored as their triangles, so no other files are needed to load a binary scene. */
+struct SceneHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t num_materials;
+	uint32_t num_objects;
+	v3 camera_position;
+	v3 camera_vectors[3];
+	float camera_fov;
+	float camera_focal_length;
+	float camera_aperture;
+	float camera_focus_distance;
+	v3 ambient_light;
+};
+
+struct SceneMaterial {
+	int32_t id;
+	v3 ks;
+	v3 ka;
+	v3 kr;
+	v3 kt;
+	v3 ke;
+	float shininess;
+	float refractive_index;
+	struct TextureParameters texture;
+};
+
+struct SceneObject {
+	uint32_t type;
+	uint32_t material; //Index into materials
+	int32_t material_id;
+	uint32_t num_lights;
+	uint32_t index;
+	float epsilon;
+	float parameters[OBJECT_MAX_PARAMETERS];
+};
+
 void cJSON_parse_float_array(const cJSON *json, float *array);
+void scene_json_load(const char *data, size_t size);
+void scene_binary_load(const uint8_t *data, size_t size);
 void camera_load(const cJSON *json);
 void materials_load(const cJSON *json);
-void material_load(const cJSON *json, size_t idx);
+void material_load(const cJSON *json);
 struct Texture *texture_load(const cJSON *json);
+void texture_colors_load(const cJSON *json, v3 colors[2]);
 void objects_load(const cJSON *json);
 void object_load(const cJSON *json, struct Object *object, enum ObjectType object_type);
 struct Object *sphere_load(const cJSON *json);
 struct Object *triangle_load(const cJSON *json);
+struct Object *quad_load(const cJSON *json);
+struct Object *disc_load(const cJSON *json);
+struct Object *cylinder_load(const cJSON *json);
+struct Object *box_load(const cJSON *json);
 #ifdef UNBOUND_OBJECTS
 struct Object *plane_load(const cJSON *json);
 #endif
-void mesh_load(const cJSON *json, size_t *i_object);
+void mesh_load(const cJSON *json, uint32_t index, size_t *i_object);
+struct Keyframe *keyframes_load(const cJSON *json, size_t *num_keyframes);
+void object_keyframes_load(const cJSON *json, size_t first_object, size_t num_animated_objects);
 void scene_scale(float scale_factor);
+void scene_save(const char *filename);
 
 static char *scene_filename;
 
@@ -73,19 +134,47 @@ void scene_load(void)
 
 	scene_filename = myargv[ARG_INPUT_FILENAME];
 
-	FILE *file_scene = fopen(scene_filename, "rb");
-	error_check(file_scene, "Unable to open scene file [%s].", scene_filename);
+	int fd = open(scene_filename, O_RDONLY);
+	error_check(fd >= 0, "Unable to open scene file [%s].", scene_filename);
+	struct stat file_stat;
+	error_check(!fstat(fd, &file_stat), "Failed to read size of scene file [%s].", scene_filename);
+	size_t size = file_stat.st_size;
+	error_check(size, "Scene file [%s] is empty.", scene_filename);
+	const uint8_t *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	error_check(data != MAP_FAILED, "Failed to map scene file [%s].", scene_filename);
+	close(fd);
+
+	if (size >= sizeof(struct SceneHeader) && !memcmp(data, SCENE_MAGIC, sizeof(SCENE_MAGIC)))
+		scene_binary_load(data, size);
+	else
+		scene_json_load((const char *)data, size);
 
-	fseek(file_scene, 0, SEEK_END);
-	size_t length = ftell(file_scene);
-	fseek(file_scene, 0, SEEK_SET);
-	char *buffer = safe_malloc(length + 1);
-	size_t nmemb_read = fread(buffer, 1, length, file_scene);
-	error_check(nmemb_read == length, "Failed to read scene file [%s].", scene_filename);
-	fclose(file_scene);
-	buffer[length] = '\0';
-	cJSON *json = cJSON_Parse(buffer);
-	free(buffer);
+	munmap((void *)data, size);
+
+	int idx = argv_check_with_args("--save-scene", 1);
+	if (idx)
+		scene_save(myargv[idx + 1]);
+
+	idx = argv_check_with_args("-r", 1);
+	if (idx) {
+		if (hash_myargv[idx + 1] == 2087865883) { //norm
+			v3 min, max, range;
+			get_objects_extents(min, max);
+			sub3v(max, min, range);
+			float scale_factor = 1.f / max3(range);
+			scene_scale(scale_factor);
+
+		} else {
+			scene_scale(atof(myargv[idx + 1]));
+		}
+	}
+
+	animation_init();
+}
+
+void scene_json_load(const char *data, const size_t size)
+{
+	cJSON *json = cJSON_ParseWithLength(data, size);
 
 	error_check(json, "Failed to parse scene [%s].", scene_filename);
 	error_check(cJSON_IsObject(json), "Expected parent token of type Object in scene [%s].", scene_filename);
@@ -105,29 +194,107 @@ void scene_load(void)
 		cJSON_parse_float_array(json_ambient_light, global_ambient_light_intensity);
 
 	cJSON_Delete(json);
+}
 
-	int idx = argv_check_with_args("-r", 1);
-	if (idx) {
-		if (hash_myargv[idx + 1] == 2087865883) { //norm
-			v3 min, max, range;
-			get_objects_extents(min, max);
-			sub3v(max, min, range);
-			float scale_factor = 1.f / max3(range);
-			scene_scale(scale_factor);
+void scene_binary_load(const uint8_t *data, const size_t size)
+{
+	const struct SceneHeader *header = (const struct SceneHeader *)data;
+	error_check(header->byte_order == SCENE_BYTE_ORDER, SCENE_ERROR_MSG("Unsupported byte order"), scene_filename);
+	error_check(header->version == SCENE_VERSION, SCENE_ERROR_MSG("Unsupported version [%u]"), header->version, scene_filename);
+	error_check(header->num_materials, SCENE_ERROR_MSG("Expected nonzero number of materials"), scene_filename);
+	error_check(size == sizeof(struct SceneHeader) + header->num_materials * sizeof(struct SceneMaterial) + (size_t)header->num_objects * sizeof(struct SceneObject),
+		SCENE_ERROR_MSG("Unexpected file size"), scene_filename);
+
+	const struct SceneMaterial *scene_materials = (const struct SceneMaterial *)(header + 1);
+	const struct SceneObject *scene_objects = (const struct SceneObject *)(scene_materials + header->num_materials);
+
+	camera_init(header->camera_position, (v3 *)header->camera_vectors, header->camera_fov, header->camera_focal_length, header->camera_aperture, header->camera_focus_distance);
+	memcpy(camera.vectors, header->camera_vectors, sizeof(v3[3])); //Already normalized, so copied to avoid rounding
+	assign3(global_ambient_light_intensity, header->ambient_light);
+
+	printf_log("Loading %u materials.", header->num_materials);
+	materials_init(header->num_materials);
+	struct Material **scene_material_map = safe_malloc(sizeof(struct Material *) * header->num_materials);
+	size_t i;
+	for (i = 0; i < header->num_materials; i++) {
+		const struct SceneMaterial *material = &scene_materials[i];
+		scene_material_map[i] = material_new(material->id, material->ks, material->ka, material->kr, material->kt, material->ke, material->shininess, material->refractive_index, texture_new(&material->texture));
+	}
 
-		} else {
-			scene_scale(atof(myargv[idx + 1]));
+	num_objects = 0;
+	num_emittant_objects = 0;
+#ifdef UNBOUND_OBJECTS
+	num_unbound_objects = 0;
+#endif
+	for (i = 0; i < header->num_objects; i++) {
+		const struct SceneObject *object = &scene_objects[i];
+		error_check(object->material < header->num_materials, SCENE_ERROR_MSG("Invalid material index [%u]"), object->material, scene_filename);
+		switch (object->type) {
+		case OBJECT_SPHERE:
+		case OBJECT_TRIANGLE:
+		case OBJECT_QUAD:
+		case OBJECT_DISC:
+		case OBJECT_CYLINDER:
+		case OBJECT_BOX:
+			break;
+		case SCENE_OBJECT_PLANE:
+#ifdef UNBOUND_OBJECTS
+			num_unbound_objects++;
+			break;
+#else
+			continue;
+#endif
+		default:
+			error(SCENE_ERROR_MSG("Invalid object type [%u]"), object->type, scene_filename);
 		}
+		num_objects++;
+		if (scene_material_map[object->material]->emittant)
+			num_emittant_objects++;
+	}
+	printf_log("Loading %zu objects.", num_objects);
+	error_check(num_objects, SCENE_ERROR_MSG("Expected nonzero number of objects"), scene_filename);
+	error_check(num_emittant_objects, SCENE_ERROR_MSG("Expected non-zero number of emittant objects"), scene_filename);
+	objects_init();
+
+	size_t i_object = 0;
+	size_t i_emittant_object = 0;
+#ifdef UNBOUND_OBJECTS
+	size_t i_unbound_object = 0;
+#endif
+	for (i = 0; i < header->num_objects; i++) {
+		const struct SceneObject *scene_object = &scene_objects[i];
+#ifndef UNBOUND_OBJECTS
+		if (scene_object->type == SCENE_OBJECT_PLANE)
+			continue;
+#endif
+		struct Object *object = object_new(scene_object->type, scene_object->parameters);
+		object_init(object, scene_material_map[scene_object->material], scene_object->epsilon, scene_object->num_lights, scene_object->type);
+		object->object_data->postinit(object);
+		object->index = scene_object->index;
+		object->material_id = scene_object->material_id;
+#ifdef UNBOUND_OBJECTS
+		if (!object->object_data->is_bounded)
+			unbound_objects[i_unbound_object++] = object;
+#endif
+		if (object->material->emittant)
+			emittant_objects[i_emittant_object++] = object;
+		objects[i_object++] = object;
 	}
+
+	free(scene_material_map);
 }
 
 void camera_load(const cJSON *json)
 {
 	printf_log("Loading camera.");
 
-	error_check(cJSON_GetArraySize(json) == 5, "Expected token [Camera] to contain 5 elements.");
-
 	cJSON *json_position, *json_vector_x, *json_vector_y, *json_fov, *json_focal_length;
+	cJSON *json_keyframes = cJSON_GetObjectItemCaseSensitive(json, "keyframes");
+	cJSON *json_aperture = cJSON_GetObjectItemCaseSensitive(json, "aperture");
+	cJSON *json_focus_distance = cJSON_GetObjectItemCaseSensitive(json, "focus_distance");
+
+	error_check(cJSON_GetArraySize(json) == 5 + !!json_keyframes + !!json_aperture + !!json_focus_distance,
+		"Expected token [Camera] to contain 5 elements, and optionally [aperture], [focus_distance], and [keyframes].");
 
 	GET_JSON_ARRAY(json_position, json, "position", 3);
 	GET_JSON_ARRAY(json_vector_x, json, "vector_x", 3);
@@ -137,32 +304,40 @@ void camera_load(const cJSON *json)
 
 	float fov = json_fov->valuedouble;
 	float focal_length = json_focal_length->valuedouble;
+	float aperture = cJSON_IsNumber(json_aperture) ? (float)json_aperture->valuedouble : 0.f;
+	float focus_distance = cJSON_IsNumber(json_focus_distance) ? (float)json_focus_distance->valuedouble : focal_length; //Image plane is in focus
 	v3 position, vectors[2];
 
 	cJSON_parse_float_array(json_position, position);
 	cJSON_parse_float_array(json_vector_x, vectors[0]);
 	cJSON_parse_float_array(json_vector_y, vectors[1]);
 
-	camera_init(position, vectors, fov, focal_length);
+	camera_init(position, vectors, fov, focal_length, aperture, focus_distance);
+
+	if (json_keyframes) {
+		size_t num_keyframes;
+		struct Keyframe *keyframes = keyframes_load(json_keyframes, &num_keyframes);
+		animation_add_camera(keyframes, num_keyframes);
+		free(keyframes);
+	}
 }
 
 void materials_load(const cJSON *json)
 {
-	num_materials = cJSON_GetArraySize(json);
-	error_check(num_materials, SCENE_ERROR_MSG("Expected token [Materials] to contain nonzero element count"), scene_filename);
-	printf_log("Loading %zu materials.", num_materials);
-	materials_init();
+	size_t num_material_definitions = cJSON_GetArraySize(json);
+	error_check(num_material_definitions, SCENE_ERROR_MSG("Expected token [Materials] to contain nonzero element count"), scene_filename);
+	printf_log("Loading %zu materials.", num_material_definitions);
+	materials_init(num_material_definitions);
 
-	size_t i = 0;
 	cJSON *json_iter;
 	cJSON_ArrayForEach (json_iter, json) {
 		error_check(cJSON_IsObject(json_iter), SCENE_ERROR_MSG("Expected token in [Materials] of type Object"), scene_filename);
-		material_load(json_iter, i);
-		i++;
+		material_load(json_iter);
 	}
+	printf_log("Loaded %zu distinct materials.", num_materials);
 }
 
-void material_load(const cJSON *json, const size_t idx)
+void material_load(const cJSON *json)
 {
 	cJSON *json_id, *json_ks, *json_ka, *json_kr, *json_kt, *json_ke, *json_shininess, *json_refractive_index, *json_texture;
 
@@ -189,7 +364,7 @@ void material_load(const cJSON *json, const size_t idx)
 	float refractive_index = json_refractive_index->valuedouble;
 	struct Texture *texture = texture_load(json_texture);
 
-	material_init(&materials[idx], id, ks, ka, kr, kt, ke, shininess, refractive_index, texture);
+	material_new(id, ks, ka, kr, kt, ke, shininess, refractive_index, texture);
 }
 
 struct Texture *texture_load(const cJSON *json)
@@ -197,35 +372,23 @@ struct Texture *texture_load(const cJSON *json)
 	cJSON *json_type;
 	GET_JSON_TYPECHECK(json_type, json, "type", String);
 
-	struct Texture *texture;
+	struct TextureParameters parameters = { 0 };
 	switch (hash_djb(json_type->valuestring)) {
 	case 3226203393: { //uniform
 		cJSON *json_color;
 		GET_JSON_ARRAY(json_color, json, "color", 3);
 
-		v3 color;
-		cJSON_parse_float_array(json_color, color);
-
-		texture = texture_uniform_new(color);
+		parameters.type = TEXTURE_UNIFORM;
+		cJSON_parse_float_array(json_color, parameters.colors[0]);
 	} break;
 	case 2234799246: { //checkerboard
 		cJSON *json_colors, *json_scale;
 		GET_JSON_ARRAY(json_colors, json, "colors", 2);
 		GET_JSON_TYPECHECK(json_scale, json, "scale", Number);
 
-		float scale = json_scale->valuedouble;
-
-		v3 colors[2];
-		cJSON *json_iter;
-		size_t i = 0;
-		cJSON_ArrayForEach (json_iter, json_colors) {
-			error_check(cJSON_IsArray(json_iter), SCENE_ERROR_MSG("Expected token in [colors] of type Array"), scene_filename);
-			error_check(cJSON_GetArraySize(json_iter) == 3, SCENE_ERROR_MSG("Expected token in [colors] of length 3"), scene_filename);
-			cJSON_parse_float_array(json_iter, colors[i]);
-			i++;
-		}
-
-		texture = texture_checkerboard_new(colors, scale);
+		parameters.type = TEXTURE_CHECKERBOARD;
+		parameters.scale = json_scale->valuedouble;
+		texture_colors_load(json_colors, parameters.colors);
 	} break;
 	case 176032948: { //brick
 		cJSON *json_colors, *json_scale, *json_mortar_width;
@@ -233,20 +396,10 @@ struct Texture *texture_load(const cJSON *json)
 		GET_JSON_TYPECHECK(json_scale, json, "scale", Number);
 		GET_JSON_TYPECHECK(json_mortar_width, json, "mortar width", Number);
 
-		float scale = json_scale->valuedouble;
-		float mortar_width = json_mortar_width->valuedouble;
-
-		v3 colors[2];
-		cJSON *json_iter;
-		size_t i = 0;
-		cJSON_ArrayForEach (json_iter, json_colors) {
-			error_check(cJSON_IsArray(json_iter), SCENE_ERROR_MSG("Expected token in [colors] of type Array"), scene_filename);
-			error_check(cJSON_GetArraySize(json_iter) == 3, SCENE_ERROR_MSG("Expected token in [colors] of length 3"), scene_filename);
-			cJSON_parse_float_array(json_iter, colors[i]);
-			i++;
-		}
-
-		texture = texture_brick_new(colors, scale, mortar_width);
+		parameters.type = TEXTURE_BRICK;
+		parameters.scale = json_scale->valuedouble;
+		parameters.mortar_width = json_mortar_width->valuedouble;
+		texture_colors_load(json_colors, parameters.colors);
 	} break;
 	case 202158024: { //noisy periodic
 		cJSON *json_color, *json_color_gradient, *json_noise_feature_scale, *json_noise_scale, *json_frequency_scale, *json_function;
@@ -257,39 +410,47 @@ struct Texture *texture_load(const cJSON *json)
 		GET_JSON_TYPECHECK(json_frequency_scale, json, "frequency scale", Number);
 		GET_JSON_TYPECHECK(json_function, json, "function", String);
 
-		float noise_feature_scale = json_noise_feature_scale->valuedouble;
-		float noise_scale = json_noise_scale->valuedouble;
-		float frequency_scale = json_frequency_scale->valuedouble;
+		parameters.type = TEXTURE_NOISY_PERIODIC;
+		parameters.noise_feature_scale = json_noise_feature_scale->valuedouble;
+		parameters.noise_scale = json_noise_scale->valuedouble;
+		parameters.frequency_scale = json_frequency_scale->valuedouble;
+		cJSON_parse_float_array(json_color, parameters.colors[0]);
+		cJSON_parse_float_array(json_color_gradient, parameters.colors[1]);
 
-		v3 color, color_gradient;
-		cJSON_parse_float_array(json_color, color);
-		cJSON_parse_float_array(json_color_gradient, color_gradient);
-
-		enum PeriodicFunction func;
 		switch (hash_djb(json_function->valuestring)) {
 		case 193433777: //sin
-			func = PERIODIC_FUNC_SIN;
+			parameters.func = PERIODIC_FUNC_SIN;
 			break;
 		case 193433504: //saw
-			func = PERIODIC_FUNC_SAW;
+			parameters.func = PERIODIC_FUNC_SAW;
 			break;
 		case 837065195: //triangle
-			func = PERIODIC_FUNC_TRIANGLE;
+			parameters.func = PERIODIC_FUNC_TRIANGLE;
 			break;
 		case 2144888260: //square
-			func = PERIODIC_FUNC_SQUARE;
+			parameters.func = PERIODIC_FUNC_SQUARE;
 			break;
 		default:
 			error(SCENE_ERROR_MSG("Unexpected value [%s] of token [function]"), json_function->valuestring, scene_filename);
 		}
-
-		texture = texture_noisy_periodic_new(color, color_gradient, noise_feature_scale, noise_scale, frequency_scale, func);
 	} break;
 	default:
 		error(SCENE_ERROR_MSG("Unrecognized token [%s] in texture"), json_type->valuestring, scene_filename);
 	}
 
-	return texture;
+	return texture_new(&parameters);
+}
+
+void texture_colors_load(const cJSON *json, v3 colors[2])
+{
+	size_t i = 0;
+	cJSON *json_iter;
+	cJSON_ArrayForEach (json_iter, json) {
+		error_check(cJSON_IsArray(json_iter), SCENE_ERROR_MSG("Expected token in [colors] of type Array"), scene_filename);
+		error_check(cJSON_GetArraySize(json_iter) == 3, SCENE_ERROR_MSG("Expected token in [colors] of length 3"), scene_filename);
+		cJSON_parse_float_array(json_iter, colors[i]);
+		i++;
+	}
 }
 
 void objects_load(const cJSON *json)
@@ -325,12 +486,15 @@ void objects_load(const cJSON *json)
 
 	size_t i_object = 0;
 	size_t i_emittant_object = 0;
+	uint32_t index = 0;
 #ifdef UNBOUND_OBJECTS
 	size_t i_unbound_object = 0;
 #endif
 	cJSON_ArrayForEach (json_iter, json) {
 		cJSON *json_type = cJSON_GetObjectItemCaseSensitive(json_iter, "type");
 		cJSON *json_parameters = cJSON_GetObjectItemCaseSensitive(json_iter, "parameters");
+		cJSON *json_keyframes = cJSON_GetObjectItemCaseSensitive(json_parameters, "keyframes");
+		size_t first_object = i_object;
 		struct Object *object;
 		switch (hash_djb(json_type->valuestring)) {
 		case 3324768284: /* Sphere */
@@ -339,17 +503,33 @@ void objects_load(const cJSON *json)
 		case 103185867: /* Triangle */
 			object = triangle_load(json_parameters);
 			break;
+		case 2089188388: /* Quad */
+			object = quad_load(json_parameters);
+			break;
+		case 2088739352: /* Disc */
+			object = disc_load(json_parameters);
+			break;
+		case 3451552871: /* Cylinder */
+			object = cylinder_load(json_parameters);
+			break;
+		case 193447888: /* Box */
+			object = box_load(json_parameters);
+			break;
 		case 232719795: /* Plane */
 #ifdef UNBOUND_OBJECTS
 			object = plane_load(json_parameters);
 			break;
 #else
+			index++;
 			continue;
 #endif
 		case 2088783990: /* Mesh */
-			mesh_load(json_parameters, &i_object);
+			mesh_load(json_parameters, index++, &i_object);
+			if (json_keyframes)
+				object_keyframes_load(json_keyframes, first_object, i_object - first_object);
 			continue;
 		}
+		object->index = index++;
 #ifdef UNBOUND_OBJECTS
 		if (!object->object_data->is_bounded)
 			unbound_objects[i_unbound_object++] = object;
@@ -357,6 +537,8 @@ void objects_load(const cJSON *json)
 		if (object->material->emittant)
 			emittant_objects[i_emittant_object++] = object;
 		objects[i_object++] = object;
+		if (json_keyframes)
+			object_keyframes_load(json_keyframes, first_object, 1);
 	}
 }
 
@@ -373,6 +555,7 @@ void object_load(const cJSON *json, struct Object *object, const enum ObjectType
 	uint32_t num_lights = cJSON_IsNumber(json_num_lights) ? json_num_lights->valueint : 0;
 
 	object_init(object, material, epsilon, num_lights, object_type);
+	object->material_id = json_material->valueint;
 }
 
 struct Object *sphere_load(const cJSON *json)
@@ -414,6 +597,92 @@ struct Object *triangle_load(const cJSON *json)
 	return triangle;
 }
 
+struct Object *quad_load(const cJSON *json)
+{
+	cJSON *json_position, *json_edge_1, *json_edge_2;
+
+	GET_JSON_ARRAY(json_position, json, "position", 3);
+	GET_JSON_ARRAY(json_edge_1, json, "edge_1", 3);
+	GET_JSON_ARRAY(json_edge_2, json, "edge_2", 3);
+
+	v3 position, edges[2];
+	cJSON_parse_float_array(json_position, position);
+	cJSON_parse_float_array(json_edge_1, edges[0]);
+	cJSON_parse_float_array(json_edge_2, edges[1]);
+
+	struct Object *quad = quad_new(position, edges);
+	object_load(json, quad, OBJECT_QUAD);
+	quad->object_data->postinit(quad);
+
+	return quad;
+}
+
+struct Object *disc_load(const cJSON *json)
+{
+	cJSON *json_position, *json_normal, *json_radius;
+
+	GET_JSON_ARRAY(json_position, json, "position", 3);
+	GET_JSON_ARRAY(json_normal, json, "normal", 3);
+	GET_JSON_TYPECHECK(json_radius, json, "radius", Number);
+
+	float radius = json_radius->valuedouble;
+
+	v3 position, normal;
+	cJSON_parse_float_array(json_position, position);
+	cJSON_parse_float_array(json_normal, normal);
+
+	struct Object *disc = disc_new(position, normal, radius);
+	object_load(json, disc, OBJECT_DISC);
+	disc->object_data->postinit(disc);
+
+	return disc;
+}
+
+struct Object *cylinder_load(const cJSON *json)
+{
+	cJSON *json_position, *json_axis, *json_radius;
+
+	GET_JSON_ARRAY(json_position, json, "position", 3);
+	GET_JSON_ARRAY(json_axis, json, "axis", 3);
+	GET_JSON_TYPECHECK(json_radius, json, "radius", Number);
+
+	float radius = json_radius->valuedouble;
+
+	v3 position, axis;
+	cJSON_parse_float_array(json_position, position);
+	cJSON_parse_float_array(json_axis, axis);
+	error_check(magsqr3(axis) > 0.f, SCENE_ERROR_MSG("Expected token [axis] of nonzero length"), scene_filename);
+
+	struct Object *cylinder = cylinder_new(position, axis, radius);
+	object_load(json, cylinder, OBJECT_CYLINDER);
+	cylinder->object_data->postinit(cylinder);
+
+	return cylinder;
+}
+
+struct Object *box_load(const cJSON *json)
+{
+	cJSON *json_position, *json_size;
+	cJSON *json_rotation = cJSON_GetObjectItemCaseSensitive(json, "rotation");
+
+	GET_JSON_ARRAY(json_position, json, "position", 3);
+	GET_JSON_ARRAY(json_size, json, "size", 3);
+
+	v3 position, size, rotation = { 0.f, 0.f, 0.f };
+	cJSON_parse_float_array(json_position, position);
+	cJSON_parse_float_array(json_size, size);
+	if (json_rotation) {
+		GET_JSON_ARRAY(json_rotation, json, "rotation", 3);
+		cJSON_parse_float_array(json_rotation, rotation);
+	}
+
+	struct Object *box = box_new(position, size, rotation);
+	object_load(json, box, OBJECT_BOX);
+	box->object_data->postinit(box);
+
+	return box;
+}
+
 #ifdef UNBOUND_OBJECTS
 struct Object *plane_load(const cJSON *json)
 {
@@ -434,7 +703,7 @@ struct Object *plane_load(const cJSON *json)
 }
 #endif
 
-void mesh_load(const cJSON *json, size_t *i_object)
+void mesh_load(const cJSON *json, const uint32_t index, size_t *i_object)
 {
 	cJSON *json_filename, *json_position, *json_rotation, *json_scale;
 
@@ -452,10 +721,50 @@ void mesh_load(const cJSON *json, size_t *i_object)
 
 	struct Object object;
 	object_load(json, &object, OBJECT_TRIANGLE);
+	object.index = index;
 
 	mesh_to_objects(filename, &object, position, rotation, scale, i_object);
 }
 
+/* Returned keyframes must be freed */
+struct Keyframe *keyframes_load(const cJSON *json, size_t *num_keyframes)
+{
+	error_check(cJSON_IsArray(json) && cJSON_GetArraySize(json), SCENE_ERROR_MSG("Expected token [keyframes] of type [Array] with nonzero element count"), scene_filename);
+
+	*num_keyframes = cJSON_GetArraySize(json);
+	struct Keyframe *keyframes = safe_calloc(*num_keyframes, sizeof(struct Keyframe));
+	size_t i = 0;
+	cJSON *json_iter;
+	cJSON_ArrayForEach (json_iter, json) {
+		cJSON *json_time;
+		cJSON *json_position = cJSON_GetObjectItemCaseSensitive(json_iter, "position");
+		cJSON *json_rotation = cJSON_GetObjectItemCaseSensitive(json_iter, "rotation");
+
+		GET_JSON_TYPECHECK(json_time, json_iter, "time", Number);
+		struct Keyframe *keyframe = &keyframes[i];
+		keyframe->time = json_time->valuedouble;
+		error_check(!i || keyframe->time > keyframes[i - 1].time, SCENE_ERROR_MSG("Expected keyframes in order of increasing [time]"), scene_filename);
+		if (json_position) {
+			GET_JSON_ARRAY(json_position, json_iter, "position", 3);
+			cJSON_parse_float_array(json_position, keyframe->position);
+		}
+		if (json_rotation) {
+			GET_JSON_ARRAY(json_rotation, json_iter, "rotation", 3);
+			cJSON_parse_float_array(json_rotation, keyframe->rotation);
+		}
+		i++;
+	}
+	return keyframes;
+}
+
+void object_keyframes_load(const cJSON *json, const size_t first_object, const size_t num_animated_objects)
+{
+	size_t num_keyframes;
+	struct Keyframe *keyframes = keyframes_load(json, &num_keyframes);
+	animation_add(first_object, num_animated_objects, keyframes, num_keyframes);
+	free(keyframes);
+}
+
 void scene_scale(const float scale_factor)
 {
 	printf_log("Scaling scene by %f.", (double)scale_factor);
@@ -467,4 +776,62 @@ void scene_scale(const float scale_factor)
 		objects[i]->object_data->scale(objects[i], zero, scale_factor);
 
 	camera_scale(zero, scale_factor);
+	animation_scale(scale_factor);
+}
+
+void scene_save(const char *filename)
+{
+	printf_log("Saving binary scene [%s].", filename);
+
+	FILE *file = fopen(filename, "wb");
+	error_check(file, "Unable to create scene file [%s].", filename);
+
+	struct SceneHeader header = {
+		.magic = SCENE_MAGIC,
+		.version = SCENE_VERSION,
+		.byte_order = SCENE_BYTE_ORDER,
+		.num_materials = num_materials,
+		.num_objects = num_objects,
+		.camera_fov = camera.fov,
+		.camera_focal_length = camera.focal_length,
+		.camera_aperture = camera.aperture,
+		.camera_focus_distance = camera.focus_distance,
+	};
+	assign3(header.camera_position, camera.position);
+	memcpy(header.camera_vectors, camera.vectors, sizeof(v3[3]));
+	assign3(header.ambient_light, global_ambient_light_intensity);
+	error_check(fwrite(&header, sizeof(struct SceneHeader), 1, file) == 1, "Failed to write scene file [%s].", filename);
+
+	size_t i;
+	for (i = 0; i < num_materials; i++) {
+		const struct Material *material = &materials[i];
+		struct SceneMaterial scene_material = {
+			.id = material->id,
+			.shininess = material->shininess,
+			.refractive_index = material->refractive_index,
+		};
+		assign3(scene_material.ks, material->ks);
+		assign3(scene_material.ka, material->ka);
+		assign3(scene_material.kr, material->kr);
+		assign3(scene_material.kt, material->kt);
+		assign3(scene_material.ke, material->ke);
+		texture_get_parameters(material->texture, &scene_material.texture);
+		error_check(fwrite(&scene_material, sizeof(struct SceneMaterial), 1, file) == 1, "Failed to write scene file [%s].", filename);
+	}
+
+	for (i = 0; i < num_objects; i++) {
+		const struct Object *object = objects[i];
+		struct SceneObject scene_object = {
+			.type = object->object_data->type,
+			.material = object->material - materials,
+			.material_id = object->material_id,
+			.num_lights = object->num_lights,
+			.index = object->index,
+			.epsilon = object->epsilon,
+		};
+		object->object_data->get_parameters(object, scene_object.parameters);
+		error_check(fwrite(&scene_object, sizeof(struct SceneObject), 1, file) == 1, "Failed to write scene file [%s].", filename);
+	}
+
+	error_check(!fclose(file), "Failed to write scene file [%s].", filename);
 }
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2021-2022 Wojciech Graj
+ *
+ * Licensed under the MIT license: https://opensource.org/licenses/MIT
+ * Permission is granted to use, copy, modify, and redistribute the work.
+ * Full license information available in the project LICENSE file.
+ *
+ * DESCRIPTION:
+ *   Ray and traversal statistics
+ **/
+
+#include "stats.h"
+
+#ifdef STATISTICS
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "system.h"
+
+#ifdef CACHE_SIMULATION
+//Typical per-core data caches with 64 byte lines and LRU replacement: 32 KiB 8-way L1, 1 MiB 16-way L2
+#define CACHE_LINE_BITS 6
+#define L1_SETS 64
+#define L1_WAYS 8
+#define L2_SETS 1024
+#define L2_WAYS 16
+
+bool cache_set_access(uint64_t *set, size_t num_ways, uint64_t line);
+
+static _Thread_local uint64_t l1_cache[L1_SETS][L1_WAYS]; //Line numbers plus 1, most recently used first. 0 is empty
+static _Thread_local uint64_t l2_cache[L2_SETS][L2_WAYS];
+#endif
+
+static const char *STAT_NAMES[NUM_STATS] = {
+	[STAT_PRIMARY_RAYS] = "primary rays",
+	[STAT_SECONDARY_RAYS] = "secondary rays",
+	[STAT_SHADOW_RAYS] = "shadow rays",
+	[STAT_BVH_NODES_VISITED] = "BVH nodes visited",
+	[STAT_BOX_TESTS] = "box tests",
+	[STAT_PRIMITIVE_TESTS] = "primitive tests",
+	[STAT_PACKET_CULLS] = "packet culls",
+	[STAT_SPHERE_HITS] = "sphere hits",
+	[STAT_TRIANGLE_HITS] = "triangle hits",
+	[STAT_QUAD_HITS] = "quad hits",
+	[STAT_DISC_HITS] = "disc hits",
+	[STAT_CYLINDER_HITS] = "cylinder hits",
+	[STAT_BOX_HITS] = "box hits",
+#ifdef UNBOUND_OBJECTS
+	[STAT_PLANE_HITS] = "plane hits",
+#endif
+#ifdef CACHE_SIMULATION
+	[STAT_CACHE_ACCESSES] = "cache accesses",
+	[STAT_L1_MISSES] = "L1 misses",
+	[STAT_L2_MISSES] = "L2 misses",
+#endif
+};
+
+_Thread_local uint64_t stats_local[NUM_STATS];
+static uint64_t stats_total[NUM_STATS];
+
+void stats_merge(void)
+{
+	size_t i;
+#ifdef MULTITHREADING
+#pragma omp critical(stats)
+#endif
+	for (i = 0; i < NUM_STATS; i++) {
+		stats_total[i] += stats_local[i];
+		stats_local[i] = 0;
+	}
+}
+
+#ifdef CACHE_SIMULATION
+//Returns true on hit. Line becomes the most recently used, evicting the least recently used on miss
+bool cache_set_access(uint64_t *set, const size_t num_ways, const uint64_t line)
+{
+	size_t i = 0;
+	while (i < num_ways - 1 && set[i] != line)
+		i++;
+	bool hit = set[i] == line;
+	memmove(&set[1], &set[0], i * sizeof(uint64_t));
+	set[0] = line;
+	return hit;
+}
+
+void stats_cache_access(const void *address)
+{
+	const uint64_t line = ((uintptr_t)address >> CACHE_LINE_BITS) + 1;
+	stats_local[STAT_CACHE_ACCESSES]++;
+	if (cache_set_access(l1_cache[line % L1_SETS], L1_WAYS, line))
+		return;
+	stats_local[STAT_L1_MISSES]++;
+	if (!cache_set_access(l2_cache[line % L2_SETS], L2_WAYS, line))
+		stats_local[STAT_L2_MISSES]++;
+}
+#endif
+
+void stats_print(const double render_time)
+{
+	printf_log("Statistics:");
+	size_t i;
+	for (i = 0; i < NUM_STATS; i++)
+		printf("%20s: %" PRIu64 "\n", STAT_NAMES[i], stats_total[i]);
+
+	uint64_t num_rays = stats_total[STAT_PRIMARY_RAYS] + stats_total[STAT_SECONDARY_RAYS] + stats_total[STAT_SHADOW_RAYS];
+	if (num_rays) {
+		printf("%20s: %.3f\n", "nodes per ray", (double)stats_total[STAT_BVH_NODES_VISITED] / num_rays);
+		printf("%20s: %.3f\n", "boxes per ray", (double)stats_total[STAT_BOX_TESTS] / num_rays);
+		printf("%20s: %.3f\n", "primitives per ray", (double)stats_total[STAT_PRIMITIVE_TESTS] / num_rays);
+#ifdef CACHE_SIMULATION
+		printf("%20s: %.3f\n", "L1 misses per ray", (double)stats_total[STAT_L1_MISSES] / num_rays);
+		printf("%20s: %.3f\n", "L2 misses per ray", (double)stats_total[STAT_L2_MISSES] / num_rays);
+#endif
+	}
+	if (render_time > 0.)
+		printf("%20s: %.0f\n", "rays per second", num_rays / render_time);
+
+	memset(stats_total, 0, sizeof(stats_total)); //Each frame of an animation is printed separately
+}
+
+#endif /* STATISTICS */
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2021-2022 Wojciech Graj
+ *
+ * Licensed under the MIT license: https://opensource.org/licenses/MIT
+ * Permission is granted to use, copy, modify, and redistribute the work.
+ * Full license information available in the project LICENSE file.
+ *
+ * DESCRIPTION:
+ *   Ray and traversal statistics. Compiled in with -DSTATISTICS
+ *   With -DCACHE_SIMULATION, memory accessed by BVH traversal is also run through a simulated cache
+ **/
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include "type.h"
+
+enum Stat {
+	STAT_PRIMARY_RAYS,
+	STAT_SECONDARY_RAYS,
+	STAT_SHADOW_RAYS,
+	STAT_BVH_NODES_VISITED,
+	STAT_BOX_TESTS,
+	STAT_PRIMITIVE_TESTS,
+	STAT_PACKET_CULLS,
+	/* Hits are ordered as enum ObjectType */
+	STAT_SPHERE_HITS,
+	STAT_TRIANGLE_HITS,
+	STAT_QUAD_HITS,
+	STAT_DISC_HITS,
+	STAT_CYLINDER_HITS,
+	STAT_BOX_HITS,
+#ifdef UNBOUND_OBJECTS
+	STAT_PLANE_HITS,
+#endif
+#ifdef CACHE_SIMULATION
+	STAT_CACHE_ACCESSES,
+	STAT_L1_MISSES,
+	STAT_L2_MISSES,
+#endif
+	NUM_STATS,
+};
+
+#ifdef STATISTICS
+#define STAT_INC(stat) (stats_local[stat]++)
+#define STAT_INC_HIT(object_type) (stats_local[STAT_SPHERE_HITS + (object_type)]++)
+
+#ifdef CACHE_SIMULATION
+#define STAT_CACHE_ACCESS(address) stats_cache_access(address)
+/* Counts whether the cache line containing address hits in the calling thread's simulated caches */
+void stats_cache_access(const void *address);
+#else
+#define STAT_CACHE_ACCESS(address) ((void)0)
+#endif
+
+/* Add the calling thread's counters to the total. Must be called by every thread which incremented a counter */
+void stats_merge(void);
+/* Print and reset the totals of a render */
+void stats_print(double render_time);
+
+extern _Thread_local uint64_t stats_local[NUM_STATS];
+#else
+#define STAT_INC(stat) ((void)0)
+#define STAT_INC_HIT(object_type) ((void)0)
+#define STAT_CACHE_ACCESS(address) ((void)0)
+#endif /* STATISTICS */
+
+#endif /* __STATS_H__ */
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2021-2022 Wojciech Graj
+ *
+ * Licensed under the MIT license: https://opensource.org/licenses/MIT
+ * Permission is granted to use, copy, modify, and redistribute the work.
+ * Full license information available in the project LICENSE file.
+ *
+ * DESCRIPTION:
+ *   Golden-image regression test which compares deterministic renders of the bundled scenes to reference images
+ **/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "argv.h"
+#include "error.h"
+#include "mem.h"
+#include "system.h"
+
+#include <tiffio.h>
+
+#define IMAGE_FILENAME "regress_image.tif"
+
+struct RegressCase {
+	const char *scene;
+	const char *reference;
+	uint32_t resolution[2];
+	uint32_t samples;
+	const char *global_illumination;
+};
+
+struct RegressImage {
+	uint32_t resolution[2];
+	uint8_t (*pixels)[3];
+};
+
+static const char *HELPTEXT =
+	"Compare deterministic renders of the bundled scenes to reference images.\n"
+	"Copyright: (c) 2021-2022 Wojciech Graj\n"
+	"License: https://opensource.org/licenses/MIT\n"
+	"\n"
+	"Usage: ./regress [OPTIONAL_PARAMETERS]\n"
+	"\n"
+	"OPTIONAL PARAMETERS:\n"
+	"[-e] (string)                    : DEFAULT = ./engine    : raytracer executable.\n"
+	"[-t] (integer | \"max\")           : DEFAULT = max         : number of CPU cores used by the raytracer.\n"
+	"[-p] (float)                     : DEFAULT = 40.0        : minimum PSNR in dB.\n"
+	"[-x] (integer)                   : DEFAULT = 64          : maximum absolute error of any channel of any pixel.\n"
+	"[-u]                             : DEFAULT = OFF         : overwrite the reference images instead of comparing against them.\n";
+
+/* Small resolutions keep the test fast. Path tracing checks that random numbers are reproducible.
+ * scene5 and scene6 are omitted because their meshes are not bundled */
+static const struct RegressCase REGRESS_CASES[] = {
+	{ "scenes/scene1.json", "scenes/golden/scene1.tif", { 80, 60 }, 1, "ambient" },
+	{ "scenes/scene2.json", "scenes/golden/scene2.tif", { 80, 60 }, 1, "ambient" },
+	{ "scenes/scene3.json", "scenes/golden/scene3.tif", { 80, 60 }, 1, "ambient" },
+	{ "scenes/scene3.json", "scenes/golden/scene3_path.tif", { 64, 48 }, 4, "path" },
+	{ "scenes/scene4.json", "scenes/golden/scene4.tif", { 80, 60 }, 1, "ambient" },
+	{ "scenes/scenetest.json", "scenes/golden/scenetest.tif", { 80, 60 }, 1, "ambient" },
+	{ "scenes/scenetest2.json", "scenes/golden/scenetest2.tif", { 80, 60 }, 1, "ambient" },
+	{ "scenes/sceneprimitives.json", "scenes/golden/sceneprimitives.tif", { 80, 60 }, 1, "ambient" },
+};
+
+int main(int argc, char *argv[]);
+bool regress_render(const char *engine, const struct RegressCase *regress_case, const char *threads, const char *filename);
+bool regress_image_load(const char *filename, struct RegressImage *regress_image);
+bool regress_compare(const struct RegressImage *image, const struct RegressImage *reference, float min_psnr, int max_error);
+
+bool regress_render(const char *engine, const struct RegressCase *regress_case, const char *threads, const char *filename)
+{
+	char resolution[2][16], samples[16];
+	snprintf(resolution[X], sizeof(resolution[X]), "%u", regress_case->resolution[X]);
+	snprintf(resolution[Y], sizeof(resolution[Y]), "%u", regress_case->resolution[Y]);
+	snprintf(samples, sizeof(samples), "%u", regress_case->samples);
+	const char *engine_argv[] = {
+		engine, regress_case->scene, filename, resolution[X], resolution[Y],
+		"-m", threads, "-n", samples, "-g", regress_case->global_illumination,
+		"--deterministic", NULL
+	};
+
+	fflush(stdout);
+	pid_t pid = fork();
+	error_check(pid >= 0, "Failed to fork.");
+	if (!pid) {
+		error_check(freopen("/dev/null", "w", stdout), "Failed to redirect output.");
+		execv(engine, (char *const *)engine_argv);
+		_exit(127);
+	}
+
+	int status;
+	error_check(waitpid(pid, &status, 0) == pid, "Failed to wait for [%s].", engine);
+	return WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+bool regress_image_load(const char *filename, struct RegressImage *regress_image)
+{
+	TIFFSetWarningHandler(0);
+	TIFF *tif = TIFFOpen(filename, "r");
+	if (!tif)
+		return false;
+
+	uint16_t samples_per_pixel, bits_per_sample;
+	TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &regress_image->resolution[X]);
+	TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &regress_image->resolution[Y]);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	if (samples_per_pixel != 3 || bits_per_sample != 8 || TIFFScanlineSize(tif) != regress_image->resolution[X] * 3) {
+		printf_log("Expected 8-bit RGB image [%s].", filename);
+		TIFFClose(tif);
+		return false;
+	}
+
+	regress_image->pixels = safe_malloc(regress_image->resolution[X] * regress_image->resolution[Y] * sizeof(uint8_t[3]));
+	uint32_t row;
+	for (row = 0; row < regress_image->resolution[Y]; row++)
+		TIFFReadScanline(tif, regress_image->pixels[row * regress_image->resolution[X]], row, 0);
+	TIFFClose(tif);
+	return true;
+}
+
+/* Returns true if image matches reference within tolerance */
+bool regress_compare(const struct RegressImage *image, const struct RegressImage *reference, const float min_psnr, const int max_error)
+{
+	if (image->resolution[X] != reference->resolution[X] || image->resolution[Y] != reference->resolution[Y]) {
+		printf_log("FAIL resolution [%ux%u] differs from reference [%ux%u].", image->resolution[X], image->resolution[Y], reference->resolution[X], reference->resolution[Y]);
+		return false;
+	}
+
+	size_t num_samples = image->resolution[X] * image->resolution[Y] * 3;
+	const uint8_t *samples = image->pixels[0], *reference_samples = reference->pixels[0];
+	double squared_error = 0.;
+	int max_abs_error = 0;
+	size_t i;
+	for (i = 0; i < num_samples; i++) {
+		int error = abs(samples[i] - reference_samples[i]);
+		squared_error += error * error;
+		if (error > max_abs_error)
+			max_abs_error = error;
+	}
+	double mse = squared_error / num_samples;
+	double psnr = mse > 0. ? 10. * log10(255. * 255. / mse) : (double)INFINITY;
+
+	bool ok = psnr >= (double)min_psnr && max_abs_error <= max_error;
+	printf_log("%s PSNR %.2fdB, max error %d.", ok ? "ok" : "FAIL", psnr, max_abs_error);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	myargc = argc;
+	myargv = argv;
+	argv_init();
+
+	if (argv_check("--help") || argv_check("-h")) {
+		puts(HELPTEXT);
+		return 0;
+	}
+
+	system_init();
+
+	int idx;
+	const char *engine = (idx = argv_check_with_args("-e", 1)) ? myargv[idx + 1] : "./engine";
+	const char *threads = (idx = argv_check_with_args("-t", 1)) ? myargv[idx + 1] : "max";
+	const float min_psnr = (idx = argv_check_with_args("-p", 1)) ? (float)atof(myargv[idx + 1]) : 40.f;
+	const int max_error = (idx = argv_check_with_args("-x", 1)) ? abs(atoi(myargv[idx + 1])) : 64;
+	const bool update = argv_check("-u");
+
+	unsigned num_failures = 0;
+	size_t i;
+	for (i = 0; i < arrlen(REGRESS_CASES); i++) {
+		const struct RegressCase *regress_case = &REGRESS_CASES[i];
+		printf_log("Rendering [%s] with [%s] at [%ux%u].", regress_case->scene, regress_case->global_illumination, regress_case->resolution[X], regress_case->resolution[Y]);
+
+		if (update) {
+			if (regress_render(engine, regress_case, threads, regress_case->reference)) {
+				printf_log("Updated [%s].", regress_case->reference);
+			} else {
+				printf_log("FAIL render.");
+				num_failures++;
+			}
+			continue;
+		}
+
+		struct RegressImage image = { 0 }, reference = { 0 };
+		if (!regress_render(engine, regress_case, threads, IMAGE_FILENAME) || !regress_image_load(IMAGE_FILENAME, &image)) {
+			printf_log("FAIL render.");
+			num_failures++;
+		} else if (!regress_image_load(regress_case->reference, &reference)) {
+			printf_log("FAIL missing reference [%s]. Run with -u to create it.", regress_case->reference);
+			num_failures++;
+		} else {
+			num_failures += !regress_compare(&image, &reference, min_psnr, max_error);
+		}
+		free(image.pixels);
+		free(reference.pixels);
+	}
+
+	remove(IMAGE_FILENAME);
+	argv_deinit();
+
+	printf_log("%u of %zu cases failed.", num_failures, arrlen(REGRESS_CASES));
+	return num_failures ? 1 : 0;
+}